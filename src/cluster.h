@@ -0,0 +1,178 @@
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include <cstdint>
+#include <vector>
+#include "protocol.h"
+
+// Messages between the Simulator processes of a distributed run. They use
+// the same framing as the generator protocol, with further message types.
+//
+//   hello:     u16 rank | u16 workers | u64 seed | u16 gridCols | u16 gridRows
+//              | u16 linkLength | u16 reserved | u32 ticks
+//   handoff:   u16 destRank | u16 count | count x record
+//   record:    u32 link | u32 arrivalTick | u32 spawnTick | u32 stoppedTicks
+//              | u8 red | u8 green | u8 blue | u8 reserved
+//   epoch end: u32 tick
+//   done:      u64 spawned | u64 exited | u64 handoffs | u64 inIntersections | u64 onLinks
+//
+// Workers advance in epochs no longer than a link takes to drive, so a
+// vehicle handed over during an epoch is never due before the epoch ends.
+// At the end of an epoch each worker sends its handoffs and an epoch end.
+// Once the coordinator has heard from every worker it forwards each one the
+// handoffs addressed to it, followed by an epoch end that releases it into
+// the next epoch.
+
+#define MSG_CLUSTER_HELLO 2
+#define MSG_HANDOFF 3
+#define MSG_EPOCH_END 4
+#define MSG_WORKER_DONE 5
+
+#define CLUSTER_HELLO_SIZE 24
+#define HANDOFF_HEADER_SIZE 4
+#define HANDOFF_RECORD_SIZE 20
+#define HANDOFF_MAX_RECORDS ((PROTOCOL_MAX_PAYLOAD - HANDOFF_HEADER_SIZE) / HANDOFF_RECORD_SIZE)
+#define EPOCH_END_SIZE 4
+#define WORKER_DONE_SIZE 40
+
+// What a worker was started with; every worker of a run must agree
+struct ClusterHello
+{
+  uint16_t rank;
+  uint16_t workers;
+  uint64_t seed;
+  uint16_t gridCols;
+  uint16_t gridRows;
+  uint16_t linkLength;
+  uint32_t ticks;
+};
+
+// A vehicle driving onto a link that ends in another worker's intersection
+struct HandoffRecord
+{
+  uint32_t link;
+  uint32_t arrivalTick;
+  uint32_t spawnTick;    // trip timing travels with the vehicle
+  uint32_t stoppedTicks;
+  uint8_t red, green, blue;
+};
+
+// Final counters of one worker, summed by the coordinator
+struct WorkerTotals
+{
+  uint64_t spawned;
+  uint64_t exited;
+  uint64_t handoffs;
+  uint64_t inIntersections;
+  uint64_t onLinks;
+};
+
+inline void appendHello(std::vector<uint8_t> &out, const ClusterHello &hello)
+{
+  uint8_t p[CLUSTER_HELLO_SIZE];
+  putU16(p, hello.rank);
+  putU16(p + 2, hello.workers);
+  putU64(p + 4, hello.seed);
+  putU16(p + 12, hello.gridCols);
+  putU16(p + 14, hello.gridRows);
+  putU16(p + 16, hello.linkLength);
+  putU16(p + 18, 0);
+  putU32(p + 20, hello.ticks);
+  appendFrame(out, MSG_CLUSTER_HELLO, p, CLUSTER_HELLO_SIZE);
+}
+
+inline bool decodeHello(const uint8_t *p, uint16_t length, ClusterHello &hello)
+{
+  if (length < CLUSTER_HELLO_SIZE)
+    return false;
+  hello.rank = getU16(p);
+  hello.workers = getU16(p + 2);
+  hello.seed = getU64(p + 4);
+  hello.gridCols = getU16(p + 12);
+  hello.gridRows = getU16(p + 14);
+  hello.linkLength = getU16(p + 16);
+  hello.ticks = getU32(p + 20);
+  return true;
+}
+
+// Packs records for one destination into as few messages as fit
+inline void appendHandoffs(std::vector<uint8_t> &out, uint16_t destRank, const HandoffRecord *records, size_t count)
+{
+  uint8_t p[PROTOCOL_MAX_PAYLOAD];
+  while (count > 0)
+  {
+    size_t n = count < HANDOFF_MAX_RECORDS ? count : HANDOFF_MAX_RECORDS;
+    putU16(p, destRank);
+    putU16(p + 2, (uint16_t)n);
+    uint8_t *r = p + HANDOFF_HEADER_SIZE;
+    for (size_t i = 0; i < n; i++, r += HANDOFF_RECORD_SIZE)
+    {
+      putU32(r, records[i].link);
+      putU32(r + 4, records[i].arrivalTick);
+      putU32(r + 8, records[i].spawnTick);
+      putU32(r + 12, records[i].stoppedTicks);
+      r[16] = records[i].red;
+      r[17] = records[i].green;
+      r[18] = records[i].blue;
+      r[19] = 0;
+    }
+    appendFrame(out, MSG_HANDOFF, p, (uint16_t)(HANDOFF_HEADER_SIZE + n * HANDOFF_RECORD_SIZE));
+    records += n;
+    count -= n;
+  }
+}
+
+// Number of records in a handoff message, 0 if it is malformed
+inline size_t handoffCount(const uint8_t *p, uint16_t length)
+{
+  if (length < HANDOFF_HEADER_SIZE)
+    return 0;
+  size_t n = getU16(p + 2);
+  return length >= HANDOFF_HEADER_SIZE + n * HANDOFF_RECORD_SIZE ? n : 0;
+}
+
+inline HandoffRecord handoffRecord(const uint8_t *p, size_t index)
+{
+  const uint8_t *r = p + HANDOFF_HEADER_SIZE + index * HANDOFF_RECORD_SIZE;
+  HandoffRecord record;
+  record.link = getU32(r);
+  record.arrivalTick = getU32(r + 4);
+  record.spawnTick = getU32(r + 8);
+  record.stoppedTicks = getU32(r + 12);
+  record.red = r[16];
+  record.green = r[17];
+  record.blue = r[18];
+  return record;
+}
+
+inline void appendEpochEnd(std::vector<uint8_t> &out, uint32_t tick)
+{
+  uint8_t p[EPOCH_END_SIZE];
+  putU32(p, tick);
+  appendFrame(out, MSG_EPOCH_END, p, EPOCH_END_SIZE);
+}
+
+inline void appendWorkerDone(std::vector<uint8_t> &out, const WorkerTotals &totals)
+{
+  uint8_t p[WORKER_DONE_SIZE];
+  putU64(p, totals.spawned);
+  putU64(p + 8, totals.exited);
+  putU64(p + 16, totals.handoffs);
+  putU64(p + 24, totals.inIntersections);
+  putU64(p + 32, totals.onLinks);
+  appendFrame(out, MSG_WORKER_DONE, p, WORKER_DONE_SIZE);
+}
+
+inline bool decodeWorkerDone(const uint8_t *p, uint16_t length, WorkerTotals &totals)
+{
+  if (length < WORKER_DONE_SIZE)
+    return false;
+  totals.spawned = getU64(p);
+  totals.exited = getU64(p + 8);
+  totals.handoffs = getU64(p + 16);
+  totals.inIntersections = getU64(p + 24);
+  totals.onLinks = getU64(p + 32);
+  return true;
+}
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Latency histogram with HdrHistogram-style log-linear buckets.
+//
+// Values below 2^HISTOGRAM_SUB_BITS get a bucket each. Above that, every
+// power of two is split into 2^HISTOGRAM_SUB_BITS equal buckets, so any
+// recorded value is known to within about 3% whatever its magnitude, in a
+// fixed 15 KB and with O(1) recording. Percentiles report the top of their
+// bucket, so they never understate a latency. Values are in microseconds.
+
+#define HISTOGRAM_SUB_BITS 5
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS (HISTOGRAM_SUB_BUCKETS * (64 - HISTOGRAM_SUB_BITS + 1))
+
+class LatencyHistogram
+{
+private:
+  std::vector<uint64_t> counts;
+  uint64_t total = 0;
+  uint64_t minValue = UINT64_MAX;
+  uint64_t maxValue = 0;
+  double sum = 0.0;
+
+  static int bucketOf(uint64_t value)
+  {
+    if (value < HISTOGRAM_SUB_BUCKETS)
+      return (int)value;
+    int exponent = HISTOGRAM_SUB_BITS;
+    while (exponent < 63 && (value >> (exponent + 1)) != 0)
+      exponent++;
+    int shift = exponent - HISTOGRAM_SUB_BITS;
+    return HISTOGRAM_SUB_BUCKETS * (shift + 1) + (int)((value >> shift) - HISTOGRAM_SUB_BUCKETS);
+  }
+
+  // Largest value that lands in a bucket
+  static uint64_t bucketTop(int bucket)
+  {
+    if (bucket < HISTOGRAM_SUB_BUCKETS)
+      return (uint64_t)bucket;
+    int shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+    uint64_t mantissa = HISTOGRAM_SUB_BUCKETS + bucket % HISTOGRAM_SUB_BUCKETS;
+    return ((mantissa + 1) << shift) - 1;
+  }
+
+public:
+  LatencyHistogram() : counts(HISTOGRAM_BUCKETS, 0)
+  {
+  }
+
+  void record(uint64_t value)
+  {
+    counts[bucketOf(value)]++;
+    total++;
+    sum += (double)value;
+    if (value < minValue)
+      minValue = value;
+    if (value > maxValue)
+      maxValue = value;
+  }
+
+  // Negative values (clocks of two hosts drifting apart) count as zero
+  void recordSigned(int64_t value)
+  {
+    record(value > 0 ? (uint64_t)value : 0);
+  }
+
+  void merge(const LatencyHistogram &other)
+  {
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+      counts[i] += other.counts[i];
+    total += other.total;
+    sum += other.sum;
+    if (other.minValue < minValue)
+      minValue = other.minValue;
+    if (other.maxValue > maxValue)
+      maxValue = other.maxValue;
+  }
+
+  uint64_t count() const
+  {
+    return total;
+  }
+
+  double mean() const
+  {
+    return total > 0 ? sum / total : 0.0;
+  }
+
+  // Smallest bucket top that at least `percentile` percent of values reach
+  uint64_t valueAt(double percentile) const
+  {
+    if (total == 0)
+      return 0;
+    uint64_t wanted = (uint64_t)(percentile / 100.0 * total + 0.5);
+    if (wanted < 1)
+      wanted = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+      seen += counts[i];
+      if (seen >= wanted)
+        return bucketTop(i) < maxValue ? bucketTop(i) : maxValue;
+    }
+    return maxValue;
+  }
+
+  // One summary line in milliseconds
+  void print(FILE *out, const char *name) const
+  {
+    if (total == 0)
+    {
+      fprintf(out, "%-24s no samples\n", name);
+      return;
+    }
+    fprintf(out, "%-24s n=%-9llu mean %9.3f  p50 %9.3f  p90 %9.3f  p99 %9.3f  p99.9 %9.3f  max %9.3f ms\n", name,
+            (unsigned long long)total, mean() / 1000.0, valueAt(50.0) / 1000.0, valueAt(90.0) / 1000.0,
+            valueAt(99.0) / 1000.0, valueAt(99.9) / 1000.0, maxValue / 1000.0);
+  }
+
+  // Percentile distribution in the HdrHistogram text layout (value in ms,
+  // percentile as a fraction, cumulative count, 1/(1-percentile)), which
+  // the usual HdrHistogram plotters read directly
+  void exportDistribution(FILE *out, const char *name) const
+  {
+    fprintf(out, "# %s\n", name);
+    fprintf(out, "%12s %14s %10s %14s\n", "Value", "Percentile", "TotalCount", "1/(1-Percentile)");
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS && seen < total; i++)
+    {
+      if (counts[i] == 0)
+        continue;
+      seen += counts[i];
+      double fraction = (double)seen / total;
+      uint64_t value = bucketTop(i) < maxValue ? bucketTop(i) : maxValue;
+      if (seen < total)
+        fprintf(out, "%12.3f %14.12f %10llu %14.2f\n", value / 1000.0, fraction, (unsigned long long)seen, 1.0 / (1.0 - fraction));
+      else
+        fprintf(out, "%12.3f %14.12f %10llu\n", value / 1000.0, fraction, (unsigned long long)seen);
+    }
+    fprintf(out, "#[Mean = %.3f, Max = %.3f, Total count = %llu]\n\n", mean() / 1000.0, maxValue / 1000.0,
+            (unsigned long long)total);
+  }
+};
+
+#endif
@@ -0,0 +1,185 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small work-stealing job scheduler.
+//
+// Every thread taking part (the workers plus the thread that called start())
+// has its own deque. A thread pushes and pops its own jobs at the back, so
+// nested work stays cache-warm, and idle threads steal the oldest job from
+// the front of someone else's deque. wait() never blocks while there is
+// work: the waiting thread runs queued jobs until its group is done.
+
+struct JobGroup
+{
+  std::atomic<int> pending{0};
+};
+
+class JobSystem
+{
+private:
+  struct Job
+  {
+    std::function<void()> fn;
+    JobGroup *group;
+  };
+
+  struct WorkerQueue
+  {
+    std::mutex mutex;
+    std::deque<Job> jobs;
+  };
+
+  std::vector<std::unique_ptr<WorkerQueue>> queues; // 0 belongs to the owning thread
+  std::vector<std::thread> workers;
+  std::atomic<bool> running{false};
+  std::atomic<int> queued{0};
+  std::atomic<int> sleepers{0};
+  std::mutex sleepMutex;
+  std::condition_variable wake;
+
+  // Index of the calling thread's queue; threads that never joined use 0
+  static int &threadIndex()
+  {
+    static thread_local int index = 0;
+    return index;
+  }
+
+  bool popLocal(int self, Job &job)
+  {
+    WorkerQueue &q = *queues[self];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.jobs.empty())
+      return false;
+    job = std::move(q.jobs.back());
+    q.jobs.pop_back();
+    return true;
+  }
+
+  bool steal(int self, Job &job)
+  {
+    int n = (int)queues.size();
+    for (int k = 1; k < n; k++)
+    {
+      WorkerQueue &q = *queues[(self + k) % n];
+      std::lock_guard<std::mutex> lock(q.mutex);
+      if (q.jobs.empty())
+        continue;
+      job = std::move(q.jobs.front());
+      q.jobs.pop_front();
+      return true;
+    }
+    return false;
+  }
+
+  // Runs one queued job if there is any
+  bool runOne(int self)
+  {
+    Job job;
+    if (!popLocal(self, job) && !steal(self, job))
+      return false;
+    queued.fetch_sub(1, std::memory_order_relaxed);
+    job.fn();
+    job.group->pending.fetch_sub(1, std::memory_order_acq_rel);
+    return true;
+  }
+
+  void workerLoop(int self)
+  {
+    threadIndex() = self;
+    while (running.load(std::memory_order_acquire))
+    {
+      if (runOne(self))
+        continue;
+      std::unique_lock<std::mutex> lock(sleepMutex);
+      sleepers.fetch_add(1);
+      wake.wait(lock, [this]() { return !running.load() || queued.load() > 0; });
+      sleepers.fetch_sub(1);
+    }
+  }
+
+public:
+  ~JobSystem()
+  {
+    stop();
+  }
+
+  // threads counts the calling thread too, so 1 runs every job inline
+  void start(int threads)
+  {
+    stop();
+    if (threads < 1)
+      threads = 1;
+    queues.clear();
+    for (int i = 0; i < threads; i++)
+      queues.emplace_back(new WorkerQueue);
+    threadIndex() = 0;
+    running = true;
+    for (int i = 1; i < threads; i++)
+      workers.emplace_back(&JobSystem::workerLoop, this, i);
+  }
+
+  void stop()
+  {
+    if (!running.exchange(false))
+      return;
+    {
+      std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_all();
+    for (std::thread &t : workers)
+      t.join();
+    workers.clear();
+  }
+
+  int threadCount() const
+  {
+    return queues.empty() ? 1 : (int)queues.size();
+  }
+
+  // Queues fn as part of group; without workers it runs immediately
+  void run(JobGroup &group, std::function<void()> fn)
+  {
+    if (workers.empty())
+    {
+      fn();
+      return;
+    }
+    group.pending.fetch_add(1, std::memory_order_relaxed);
+    {
+      WorkerQueue &q = *queues[threadIndex()];
+      std::lock_guard<std::mutex> lock(q.mutex);
+      q.jobs.push_back({std::move(fn), &group});
+    }
+    queued.fetch_add(1);
+    // Busy workers pick the job up on their own; only sleepers need the syscall
+    if (sleepers.load() > 0)
+    {
+      {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+      }
+      wake.notify_one();
+    }
+  }
+
+  // Helps with queued jobs until every job of group has finished
+  void wait(JobGroup &group)
+  {
+    int self = threadIndex();
+    while (group.pending.load(std::memory_order_acquire) > 0)
+    {
+      if (!runOne(self))
+        std::this_thread::yield();
+    }
+  }
+};
+
+#endif
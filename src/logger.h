@@ -0,0 +1,224 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Asynchronous leveled logger shared by the Simulator and the Traffic Generator.
+//
+// Callers format into a slot of a bounded lock-free ring and return immediately;
+// a background thread writes the ring out and flushes once per drain. If the ring
+// is full the message is dropped and counted instead of stalling the caller.
+// LOG_VEHICLE is the per-vehicle level, so --log-level info silences those entirely.
+
+#define LOG_RING_SIZE 8192 // power of two
+#define LOG_LINE_SIZE 240
+#define LOG_FLUSH_INTERVAL_MS 20
+
+enum LogLevel
+{
+  LOG_ERROR,
+  LOG_WARN,
+  LOG_INFO,
+  LOG_VEHICLE
+};
+
+struct LogSlot
+{
+  std::atomic<size_t> sequence;
+  LogLevel level;
+  char text[LOG_LINE_SIZE];
+};
+
+struct LoggerState
+{
+  std::unique_ptr<LogSlot[]> slots;
+  alignas(64) std::atomic<size_t> writePos{0};
+  alignas(64) size_t readPos = 0; // guarded by drainMutex
+  std::atomic<int> level{LOG_VEHICLE};
+  std::atomic<unsigned long long> dropped{0};
+  std::atomic<bool> running{false};
+  std::mutex drainMutex;
+  std::mutex wakeMutex;
+  std::condition_variable wake;
+  std::thread flusher;
+
+  // Writes every pending line to stdout/stderr
+  void drain()
+  {
+    if (!slots)
+      return;
+
+    std::lock_guard<std::mutex> lock(drainMutex);
+    bool wroteOut = false, wroteErr = false;
+    while (true)
+    {
+      LogSlot &slot = slots[readPos & (LOG_RING_SIZE - 1)];
+      if (slot.sequence.load(std::memory_order_acquire) != readPos + 1)
+        break;
+
+      FILE *out = slot.level <= LOG_WARN ? stderr : stdout;
+      fputs(slot.text, out);
+      fputc('\n', out);
+      (out == stderr ? wroteErr : wroteOut) = true;
+
+      slot.sequence.store(readPos + LOG_RING_SIZE, std::memory_order_release);
+      readPos++;
+    }
+
+    unsigned long long lost = dropped.exchange(0, std::memory_order_relaxed);
+    if (lost > 0)
+    {
+      fprintf(stderr, "[log] %llu messages dropped (log buffer full)\n", lost);
+      wroteErr = true;
+    }
+    if (wroteOut)
+      fflush(stdout);
+    if (wroteErr)
+      fflush(stderr);
+  }
+
+  // Stops the flusher and writes out whatever is left
+  void stop()
+  {
+    if (!running.exchange(false))
+      return;
+    wake.notify_all();
+    if (flusher.joinable())
+      flusher.join();
+  }
+
+  // Covers early returns that never reached logStop()
+  ~LoggerState()
+  {
+    stop();
+  }
+};
+
+inline LoggerState &loggerState()
+{
+  static LoggerState state;
+  return state;
+}
+
+inline bool logEnabled(LogLevel level)
+{
+  return (int)level <= loggerState().level.load(std::memory_order_relaxed);
+}
+
+inline void logSetLevel(LogLevel level)
+{
+  loggerState().level.store(level, std::memory_order_relaxed);
+}
+
+// Accepts error, warn, info or vehicle
+inline bool parseLogLevel(const char *name, LogLevel &level)
+{
+  static const char *names[] = {"error", "warn", "info", "vehicle"};
+  for (int i = 0; i <= LOG_VEHICLE; i++)
+  {
+    if (strcmp(name, names[i]) == 0)
+    {
+      level = (LogLevel)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Writes every pending line to stdout/stderr; safe to call from any thread
+inline void logDrain()
+{
+  loggerState().drain();
+}
+
+// Formats a message into the ring; never blocks
+inline void logWrite(LogLevel level, const char *fmt, ...)
+{
+  if (!logEnabled(level))
+    return;
+
+  LoggerState &state = loggerState();
+  if (!state.slots)
+  {
+    // Logger not started yet: fall back to a direct write
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(level <= LOG_WARN ? stderr : stdout, fmt, args);
+    va_end(args);
+    fputc('\n', level <= LOG_WARN ? stderr : stdout);
+    return;
+  }
+
+  size_t pos = state.writePos.load(std::memory_order_relaxed);
+  LogSlot *slot;
+  while (true)
+  {
+    slot = &state.slots[pos & (LOG_RING_SIZE - 1)];
+    size_t seq = slot->sequence.load(std::memory_order_acquire);
+    intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+    if (diff == 0)
+    {
+      if (state.writePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        break;
+    }
+    else if (diff < 0)
+    {
+      state.dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    else
+    {
+      pos = state.writePos.load(std::memory_order_relaxed);
+    }
+  }
+
+  slot->level = level;
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(slot->text, LOG_LINE_SIZE, fmt, args);
+  va_end(args);
+  slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+// Allocates the ring and starts the background flusher
+inline void logStart(LogLevel level)
+{
+  LoggerState &state = loggerState();
+  logSetLevel(level);
+  if (state.running.load())
+    return;
+
+  state.slots.reset(new LogSlot[LOG_RING_SIZE]);
+  for (size_t i = 0; i < LOG_RING_SIZE; i++)
+    state.slots[i].sequence.store(i, std::memory_order_relaxed);
+  state.writePos = 0;
+  state.readPos = 0;
+  state.running = true;
+
+  state.flusher = std::thread([&state]() {
+    while (state.running.load(std::memory_order_relaxed))
+    {
+      state.drain();
+      std::unique_lock<std::mutex> lock(state.wakeMutex);
+      state.wake.wait_for(lock, std::chrono::milliseconds(LOG_FLUSH_INTERVAL_MS));
+    }
+    state.drain();
+  });
+}
+
+// Flushes everything still queued and stops the flusher
+inline void logStop()
+{
+  loggerState().stop();
+}
+
+#endif
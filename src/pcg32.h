@@ -0,0 +1,43 @@
+#ifndef PCG32_H
+#define PCG32_H
+
+#include <cstdint>
+
+// Small, fast PCG32 generator shared by the Simulator and the Traffic Generator.
+// Unlike rand() its output is the same on every platform, so a seed fully
+// reproduces a run. Different stream numbers give independent sequences.
+struct Pcg32
+{
+  uint64_t state;
+  uint64_t inc;
+
+  Pcg32(uint64_t seed, uint64_t stream) : state(0), inc((stream << 1u) | 1u)
+  {
+    next();
+    state += seed;
+    next();
+  }
+
+  uint32_t next()
+  {
+    uint64_t old = state;
+    state = old * 6364136223846793005ULL + inc;
+    uint32_t xorshifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+    uint32_t rot = (uint32_t)(old >> 59u);
+    return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+  }
+
+  // Uniform integer in [0, bound)
+  uint32_t below(uint32_t bound)
+  {
+    return (uint32_t)(((uint64_t)next() * bound) >> 32);
+  }
+
+  // Uniform double in [0, 1)
+  double uniform()
+  {
+    return next() * (1.0 / 4294967296.0);
+  }
+};
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+// Binary wire protocol between the Traffic Generator and the Simulator.
+//
+// Every message is a fixed 6-byte header followed by `length` payload bytes.
+// All multi-byte fields are big-endian (network order).
+//
+//   header:  u16 magic | u8 version | u8 type | u16 length
+//   vehicle: u32 vehicleId | u8 lane | u8 road | u8 pathOption | u8 reserved | i64 generatedUs
+//            | i64 sentUs
+//
+// sentUs was added later; 16-byte vehicle payloads from older generators are
+// still accepted and decode with sentUs = 0.
+
+#define PROTOCOL_MAGIC 0x5456 // "TV"
+#define PROTOCOL_VERSION 1
+#define PROTOCOL_HEADER_SIZE 6
+#define PROTOCOL_MAX_PAYLOAD 1024
+
+#define MSG_VEHICLE 1
+
+#define VEHICLE_PAYLOAD_SIZE 24
+#define VEHICLE_PAYLOAD_MIN_SIZE 16
+#define VEHICLE_MESSAGE_SIZE (PROTOCOL_HEADER_SIZE + VEHICLE_PAYLOAD_SIZE)
+
+// One vehicle as it travels over the wire
+struct VehicleMessage
+{
+  uint32_t vehicleId;
+  uint8_t lane;
+  uint8_t road;
+  uint8_t pathOption;
+  int64_t generatedUs; // steady clock microseconds when the generator created it
+  int64_t sentUs;      // same clock when it left the generator's queue, 0 if unknown
+};
+
+inline void putU16(uint8_t *p, uint16_t v)
+{
+  p[0] = (uint8_t)(v >> 8);
+  p[1] = (uint8_t)v;
+}
+
+inline void putU32(uint8_t *p, uint32_t v)
+{
+  for (int i = 0; i < 4; i++)
+    p[i] = (uint8_t)(v >> (24 - 8 * i));
+}
+
+inline void putU64(uint8_t *p, uint64_t v)
+{
+  for (int i = 0; i < 8; i++)
+    p[i] = (uint8_t)(v >> (56 - 8 * i));
+}
+
+inline uint16_t getU16(const uint8_t *p)
+{
+  return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+inline uint32_t getU32(const uint8_t *p)
+{
+  uint32_t v = 0;
+  for (int i = 0; i < 4; i++)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+inline uint64_t getU64(const uint8_t *p)
+{
+  uint64_t v = 0;
+  for (int i = 0; i < 8; i++)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+inline void putHeader(uint8_t *out, uint8_t type, uint16_t length)
+{
+  putU16(out, PROTOCOL_MAGIC);
+  out[2] = PROTOCOL_VERSION;
+  out[3] = type;
+  putU16(out + 4, length);
+}
+
+// Appends one framed message of any type (length at most PROTOCOL_MAX_PAYLOAD)
+inline void appendFrame(std::vector<uint8_t> &out, uint8_t type, const uint8_t *payload, uint16_t length)
+{
+  uint8_t header[PROTOCOL_HEADER_SIZE];
+  putHeader(header, type, length);
+  out.insert(out.end(), header, header + PROTOCOL_HEADER_SIZE);
+  out.insert(out.end(), payload, payload + length);
+}
+
+// Writes one framed vehicle message into out (must hold VEHICLE_MESSAGE_SIZE bytes)
+inline size_t encodeVehicleMessage(const VehicleMessage &msg, uint8_t *out)
+{
+  putHeader(out, MSG_VEHICLE, VEHICLE_PAYLOAD_SIZE);
+
+  uint8_t *p = out + PROTOCOL_HEADER_SIZE;
+  putU32(p, msg.vehicleId);
+  p[4] = msg.lane;
+  p[5] = msg.road;
+  p[6] = msg.pathOption;
+  p[7] = 0;
+  putU64(p + 8, (uint64_t)msg.generatedUs);
+  putU64(p + 16, (uint64_t)msg.sentUs);
+  return VEHICLE_MESSAGE_SIZE;
+}
+
+// Streaming decoder that reassembles messages from arbitrary recv() chunks,
+// so partial and coalesced reads are both handled.
+class FrameDecoder
+{
+private:
+  std::vector<uint8_t> buffer;
+  size_t readPos = 0;
+  uint64_t badBytes = 0;
+
+public:
+  // Appends freshly received bytes
+  void feed(const char *data, size_t len)
+  {
+    // Compact once the consumed prefix dominates the buffer
+    if (readPos > 0 && readPos * 2 >= buffer.size())
+    {
+      buffer.erase(buffer.begin(), buffer.begin() + readPos);
+      readPos = 0;
+    }
+    buffer.insert(buffer.end(), (const uint8_t *)data, (const uint8_t *)data + len);
+  }
+
+  // Extracts the next complete message of any type, returns false if more
+  // bytes are needed. payload points into the decoder until the next feed().
+  bool nextFrame(uint8_t &type, const uint8_t *&payload, uint16_t &length)
+  {
+    while (buffer.size() - readPos >= PROTOCOL_HEADER_SIZE)
+    {
+      const uint8_t *h = buffer.data() + readPos;
+      length = getU16(h + 4);
+
+      // Resynchronise one byte at a time on garbage
+      if (getU16(h) != PROTOCOL_MAGIC || h[2] != PROTOCOL_VERSION || length > PROTOCOL_MAX_PAYLOAD)
+      {
+        readPos++;
+        badBytes++;
+        continue;
+      }
+
+      if (buffer.size() - readPos < (size_t)PROTOCOL_HEADER_SIZE + length)
+        return false;
+
+      type = h[3];
+      payload = h + PROTOCOL_HEADER_SIZE;
+      readPos += PROTOCOL_HEADER_SIZE + length;
+      return true;
+    }
+    return false;
+  }
+
+  // Extracts the next complete vehicle message, returns false if more bytes are needed
+  bool next(VehicleMessage &msg)
+  {
+    uint8_t type;
+    const uint8_t *p;
+    uint16_t length;
+    while (nextFrame(type, p, length))
+    {
+      // Unknown or short messages are skipped so newer senders stay compatible
+      if (type != MSG_VEHICLE || length < VEHICLE_PAYLOAD_MIN_SIZE)
+        continue;
+
+      msg.vehicleId = getU32(p);
+      msg.lane = p[4];
+      msg.road = p[5];
+      msg.pathOption = p[6];
+      msg.generatedUs = (int64_t)getU64(p + 8);
+      msg.sentUs = length >= VEHICLE_PAYLOAD_SIZE ? (int64_t)getU64(p + 16) : 0;
+      return true;
+    }
+    return false;
+  }
+
+  uint64_t getBadBytes() const
+  {
+    return badBytes;
+  }
+};
+
+#endif
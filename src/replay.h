@@ -0,0 +1,297 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "protocol.h"
+
+// Binary event log of a simulation run, used to reproduce it exactly.
+//
+// The Simulator is deterministic once its random seed and the tick of every
+// arrival are fixed, so that is all the log holds. Multi-byte fields are
+// big-endian, like the wire protocol.
+//
+//   header:  u32 magic | u8 version | u8 reserved | u16 stepMs | u64 seed
+//            | u16 gridCols | u16 gridRows | u16 linkLength | u16 reserved
+//   record:  u8 type | u32 tick | payload
+//   arrival: u16 intersection | u8 lane | u8 pathOption
+//   light:   u16 intersection | u8 phase (0 = all red while switching, 1-4 = green road)
+//   end:     no payload, tick is the last simulated step
+//
+// Vehicles handed between intersections are not logged; they follow from
+// the arrivals and the network shape in the header.
+
+#define REPLAY_MAGIC 0x54535250 // "TSRP"
+#define REPLAY_VERSION 3
+#define REPLAY_HEADER_SIZE 24
+#define REPLAY_RECORD_HEADER_SIZE 5
+#define REPLAY_MAX_PAYLOAD 4
+#define REPLAY_FLUSH_BYTES 65536
+
+#define REPLAY_ARRIVAL 1
+#define REPLAY_LIGHT 2
+#define REPLAY_END 3
+
+struct ReplayRecord
+{
+  uint8_t type;
+  uint32_t tick;
+  uint16_t intersection;
+  uint8_t lane;
+  uint8_t pathOption;
+  uint8_t phase;
+};
+
+// Road network a run was recorded on
+struct ReplayNetwork
+{
+  uint16_t gridCols;
+  uint16_t gridRows;
+  uint16_t linkLength;
+};
+
+// Appends records to an in-memory buffer and hands full buffers to a
+// background thread for the actual fwrite, so the simulation loop never
+// waits on the disk.
+class ReplayWriter
+{
+private:
+  FILE *file = nullptr;
+  std::vector<uint8_t> buffer;
+  std::vector<std::vector<uint8_t>> full; // guarded by mutex
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::thread writer;
+  bool stopping = false;
+  uint64_t records = 0;
+  uint32_t lastTick = 0;
+
+  void writeLoop()
+  {
+    std::vector<std::vector<uint8_t>> batch;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+      wake.wait(lock, [this]() { return stopping || !full.empty(); });
+      batch.swap(full);
+      bool done = stopping;
+      lock.unlock();
+
+      for (const std::vector<uint8_t> &chunk : batch)
+      {
+        if (fwrite(chunk.data(), 1, chunk.size(), file) != chunk.size())
+          perror("Replay write failed");
+      }
+      batch.clear();
+
+      lock.lock();
+      if (done && full.empty())
+        return;
+    }
+  }
+
+  void append(uint8_t type, uint32_t tick, const uint8_t *payload, size_t length)
+  {
+    if (!file)
+      return;
+    uint8_t record[REPLAY_RECORD_HEADER_SIZE + REPLAY_MAX_PAYLOAD];
+    record[0] = type;
+    putU32(record + 1, tick);
+    if (length > 0)
+      memcpy(record + REPLAY_RECORD_HEADER_SIZE, payload, length);
+    buffer.insert(buffer.end(), record, record + REPLAY_RECORD_HEADER_SIZE + length);
+    records++;
+    lastTick = tick;
+
+    if (buffer.size() >= REPLAY_FLUSH_BYTES)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      full.push_back(std::move(buffer));
+      buffer.clear();
+      buffer.reserve(REPLAY_FLUSH_BYTES + 16);
+      wake.notify_one();
+    }
+  }
+
+public:
+  // Covers early returns that never reached close()
+  ~ReplayWriter()
+  {
+    close(lastTick);
+  }
+
+  bool open(const char *path, uint64_t seed, uint16_t stepMs, const ReplayNetwork &net)
+  {
+    file = fopen(path, "wb");
+    if (!file)
+    {
+      perror("Failed to open replay file");
+      return false;
+    }
+
+    uint8_t header[REPLAY_HEADER_SIZE];
+    putU32(header, REPLAY_MAGIC);
+    header[4] = REPLAY_VERSION;
+    header[5] = 0;
+    putU16(header + 6, stepMs);
+    putU64(header + 8, seed);
+    putU16(header + 16, net.gridCols);
+    putU16(header + 18, net.gridRows);
+    putU16(header + 20, net.linkLength);
+    putU16(header + 22, 0);
+    buffer.reserve(REPLAY_FLUSH_BYTES + 16);
+    buffer.insert(buffer.end(), header, header + REPLAY_HEADER_SIZE);
+
+    stopping = false;
+    writer = std::thread(&ReplayWriter::writeLoop, this);
+    return true;
+  }
+
+  bool isOpen() const
+  {
+    return file != nullptr;
+  }
+
+  uint64_t recordCount() const
+  {
+    return records;
+  }
+
+  void arrival(uint32_t tick, int intersection, int lane, int pathOption)
+  {
+    uint8_t payload[4];
+    putU16(payload, (uint16_t)intersection);
+    payload[2] = (uint8_t)lane;
+    payload[3] = (uint8_t)pathOption;
+    append(REPLAY_ARRIVAL, tick, payload, 4);
+  }
+
+  void lightChange(uint32_t tick, int intersection, int phase)
+  {
+    uint8_t payload[3];
+    putU16(payload, (uint16_t)intersection);
+    payload[2] = (uint8_t)phase;
+    append(REPLAY_LIGHT, tick, payload, 3);
+  }
+
+  // Writes the end marker, flushes everything and closes the file
+  void close(uint32_t endTick)
+  {
+    if (!file)
+      return;
+    append(REPLAY_END, endTick, nullptr, 0);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!buffer.empty())
+        full.push_back(std::move(buffer));
+      buffer.clear();
+      stopping = true;
+    }
+    wake.notify_one();
+    if (writer.joinable())
+      writer.join();
+    fclose(file);
+    file = nullptr;
+  }
+};
+
+// Reads a replay log back one record at a time
+class ReplayReader
+{
+private:
+  FILE *file = nullptr;
+  uint64_t seed = 0;
+  uint16_t stepMs = 0;
+  ReplayNetwork network = {1, 1, 0};
+
+public:
+  ~ReplayReader()
+  {
+    if (file)
+      fclose(file);
+  }
+
+  bool open(const char *path)
+  {
+    file = fopen(path, "rb");
+    if (!file)
+    {
+      perror("Failed to open replay file");
+      return false;
+    }
+
+    uint8_t header[REPLAY_HEADER_SIZE];
+    if (fread(header, 1, REPLAY_HEADER_SIZE, file) != REPLAY_HEADER_SIZE ||
+        getU32(header) != REPLAY_MAGIC || header[4] != REPLAY_VERSION)
+    {
+      fprintf(stderr, "%s is not a replay file of version %d\n", path, REPLAY_VERSION);
+      fclose(file);
+      file = nullptr;
+      return false;
+    }
+    stepMs = getU16(header + 6);
+    seed = getU64(header + 8);
+    network.gridCols = getU16(header + 16);
+    network.gridRows = getU16(header + 18);
+    network.linkLength = getU16(header + 20);
+    return true;
+  }
+
+  uint64_t getSeed() const
+  {
+    return seed;
+  }
+
+  uint16_t getStepMs() const
+  {
+    return stepMs;
+  }
+
+  const ReplayNetwork &getNetwork() const
+  {
+    return network;
+  }
+
+  // False at end of file or on a truncated or unknown record
+  bool next(ReplayRecord &record)
+  {
+    if (!file)
+      return false;
+
+    uint8_t head[REPLAY_RECORD_HEADER_SIZE];
+    if (fread(head, 1, REPLAY_RECORD_HEADER_SIZE, file) != REPLAY_RECORD_HEADER_SIZE)
+      return false;
+    record.type = head[0];
+    record.tick = getU32(head + 1);
+
+    uint8_t payload[REPLAY_MAX_PAYLOAD];
+    switch (record.type)
+    {
+    case REPLAY_ARRIVAL:
+      if (fread(payload, 1, 4, file) != 4)
+        return false;
+      record.intersection = getU16(payload);
+      record.lane = payload[2];
+      record.pathOption = payload[3];
+      return true;
+    case REPLAY_LIGHT:
+      if (fread(payload, 1, 3, file) != 3)
+        return false;
+      record.intersection = getU16(payload);
+      record.phase = payload[2];
+      return true;
+    case REPLAY_END:
+      return true;
+    default:
+      fprintf(stderr, "Unknown replay record type %d\n", record.type);
+      return false;
+    }
+  }
+};
+
+#endif
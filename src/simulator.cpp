@@ -1,16 +1,30 @@
 #include <iostream>
 #include <algorithm>
 #include <vector>
+#include <deque>
+#include <unordered_map>
 #include <string>
 #include <sstream>
 #include <thread>
 #include <mutex>
 #include <atomic>
+#include <chrono>
+#include <cstdlib>
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_ttf.h>
 #include <cstdio>
 #include <cstring>
 #include <cmath>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+#include "protocol.h"
+#include "logger.h"
+#include "pcg32.h"
+#include "replay.h"
+#include "jobs.h"
+#include "cluster.h"
+#include "histogram.h"
 #ifdef _WIN32
 #include <winsock2.h>
 #include <ws2tcpip.h>
@@ -18,6 +32,7 @@
 #else
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #define closesocket close
@@ -25,19 +40,144 @@ typedef int SOCKET;
 #endif
 
 #define PORT 5000
-#define BUFFER_SIZE 100
+#define DEFAULT_CLUSTER_PORT 5100
+#define CLUSTER_CONNECT_TIMEOUT_MS 10000 // workers may start before the coordinator
+#define BUFFER_SIZE 4096
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 800
 #define ROAD_WIDTH 150
 #define LANE_WIDTH 50
+#define SIM_DT_MS 16                    // fixed simulation step
+#define SIM_DT (SIM_DT_MS / 1000.0f)   // same step in seconds
+#define VEHICLE_SPEED 125.0f           // pixels per second of simulated time
+#define MAX_FRAME_MS 250.0             // wall time credited per frame at most, so a stall does not snowball
+#define MAX_STEPS_PER_FRAME 2000       // beyond this the windowed loop drops the backlog
+#define MAX_SCALE_FRAME_NS 14000000ULL // simulation budget per frame at "max" speed
+#define DEFAULT_INGEST_CAPACITY 4096
+#define CACHE_LINE_SIZE 64
+#define TEXT_CACHE_MAX_ENTRIES 256
+#define PARALLEL_LANE_MIN_VEHICLES 256 // below this a lane-parallel sweep costs more than it saves
+#define REGIONS_PER_THREAD 4           // spare regions let idle threads steal work from busy ones
 
 #define MAIN_FONT "C:/Windows/Fonts/arial.ttf"
 
 // Global atomic variables for thread-safe light state
-std::atomic<int> currentLight = 0;
-std::atomic<int> nextLight = 0;
-std::mutex vehicleQueueMutex;
-std::vector<std::string> vehicleQueue;
+std::atomic<int> currentLight = 0; // phase of the viewed intersection last logged by trackViewLight
+
+// What the producer does when the ingest ring is full
+enum OverflowPolicy
+{
+  OVERFLOW_DROP,  // discard the new record and count it
+  OVERFLOW_BLOCK  // wait for the consumer to make room, counting each stall
+};
+
+// Fixed-size record handed from the network thread to the simulation loop
+struct IncomingVehicle
+{
+  int vehicleId;
+  int lane;
+  int pathOption;
+  Sint64 generatedUs;   // generator's steady clock stamp
+  Sint64 sentUs;        // same clock when the generator sent it, 0 if unknown
+  double receivedMs;    // steady clock time the network thread saw it
+  Uint64 receivedStep;  // simulation step counter at that moment
+};
+
+// Bounded single-producer/single-consumer lock-free ring buffer.
+// Capacity is rounded up to a power of two so indices wrap with a mask.
+template <typename T>
+class SpscRing
+{
+private:
+  std::vector<T> slots;
+  size_t mask = 0;
+  OverflowPolicy policy = OVERFLOW_DROP;
+  alignas(CACHE_LINE_SIZE) std::atomic<size_t> head{0}; // next slot to read, owned by consumer
+  alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail{0}; // next slot to write, owned by producer
+  alignas(CACHE_LINE_SIZE) std::atomic<Uint64> overflowCount{0};
+
+public:
+  // Must be called before either thread touches the ring
+  void init(size_t capacity, OverflowPolicy overflow)
+  {
+    size_t size = 1;
+    while (size < capacity)
+      size <<= 1;
+    slots.assign(size, T());
+    mask = size - 1;
+    policy = overflow;
+    head = 0;
+    tail = 0;
+    overflowCount = 0;
+  }
+
+  // Producer side: returns false if the record was dropped
+  bool push(const T &item)
+  {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) >= slots.size())
+    {
+      // Counted once per record that found the ring full, not per retry
+      overflowCount.fetch_add(1, std::memory_order_relaxed);
+      if (policy == OVERFLOW_DROP)
+        return false;
+      while (t - head.load(std::memory_order_acquire) >= slots.size())
+        std::this_thread::yield();
+    }
+    slots[t & mask] = item;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side: returns false if the ring is empty
+  bool pop(T &item)
+  {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire))
+      return false;
+    item = slots[h & mask];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t size() const
+  {
+    return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+  }
+
+  size_t capacity() const
+  {
+    return slots.size();
+  }
+
+  Uint64 getOverflowCount() const
+  {
+    return overflowCount.load(std::memory_order_relaxed);
+  }
+};
+
+SpscRing<IncomingVehicle> vehicleRing;
+std::atomic<Uint64> stepCounter{0};
+size_t ingestBudget = 0; // max vehicles spawned per simulation step, 0 drains everything
+
+// Running totals for how long vehicles wait between receipt and spawn
+struct IngestStats
+{
+  Uint64 spawned;
+  Uint64 batches;
+  size_t largestBatch;
+  double totalLagMs;
+  double maxLagMs;
+  Uint64 totalLagSteps;
+  Uint64 maxLagSteps;
+};
+
+IngestStats ingestStats = {0, 0, 0, 0.0, 0.0, 0, 0};
+
+// Wall-clock latency of generator vehicles, from the stamps they carry
+LatencyHistogram generatorQueueLatency; // created to sent, inside the generator
+LatencyHistogram ingestLatency;         // sent to spawned: network, ring and step wait
+const char *latencyReportPath = nullptr;
 
 struct SharedData
 {
@@ -45,6 +185,13 @@ struct SharedData
   int nextLight;
 };
 
+// Timing a vehicle carries with it from intersection to intersection
+struct Trip
+{
+  Uint32 spawnTick;    // step it entered the network
+  Uint32 stoppedTicks; // steps spent standing at a stop line or in a queue
+};
+
 // Main vehicle structure with physics and state
 struct Vehicle
 {
@@ -58,129 +205,2289 @@ struct Vehicle
   
   bool turning;
   float t;
-  float t_speed;
-  float p0x, p0y;
-  float p1x, p1y;
-  float p2x, p2y;
   int targetLane;
   bool targetHorizontal;
+  Trip trip;
 };
 
-std::vector<Vehicle> activeVehicles;
+#define MAX_LANES 13 // lanes are numbered 1-12
 
-bool initializeSDL(SDL_Window **window, SDL_Renderer **renderer);
-void drawRoadsAndLane(SDL_Renderer *renderer, TTF_Font *font);
-void displayText(SDL_Renderer *renderer, TTF_Font *font, const char *text, int x, int y);
-void refreshLight(SDL_Renderer *renderer);
-void drawLightForB(SDL_Renderer *renderer, bool isRed);
-void drawArrow(SDL_Renderer *renderer, int x1, int y1, int x2, int y2, int x3, int y3);
+// True if position a is further along than position b in the direction lane travels
+bool laneAhead(int lane, float ax, float ay, float bx, float by)
+{
+  if (lane >= 1 && lane <= 3)
+    return ay > by; // southbound
+  if (lane >= 4 && lane <= 6)
+    return ay < by; // northbound
+  if (lane >= 7 && lane <= 9)
+    return ax < bx; // westbound
+  return ax > bx;   // eastbound
+}
 
-void drawLightForA(SDL_Renderer *renderer, bool isRed);
-void drawLightForB(SDL_Renderer *renderer, bool isRed);
-void drawLightForC(SDL_Renderer *renderer, bool isRed);
-void drawLightForD(SDL_Renderer *renderer, bool isRed);
+// Road (0-3) a vehicle is queued on before the stop line, or -1
+int waitingRoadFor(int lane, float x, float y, bool turning)
+{
+  if (turning)
+    return -1;
+  if (lane >= 1 && lane <= 3)
+    return y <= 295 ? 0 : -1;
+  if (lane >= 4 && lane <= 6)
+    return y >= 465 ? 1 : -1;
+  if (lane >= 7 && lane <= 9)
+    return x >= 465 ? 2 : -1;
+  if (lane >= 10 && lane <= 12)
+    return x <= 295 ? 3 : -1;
+  return -1;
+}
 
-void drawTrafficLight(SDL_Renderer *renderer, float x, float y, bool isRed, bool horizontal);
+#define HEADING_LUT_SIZE 4096 // entries per full turn, power of two
 
-void drawCar(SDL_Renderer *renderer, Vehicle &v);
+// Unit direction of a heading: cosine and sine of its angle
+struct Heading
+{
+  float c, s;
+};
 
-void spawnVehicle(int lane);
-void updateVehicles();
+// Direction a lane travels in. Straight vehicles only ever use these four,
+// so they are exact constants with no trig at all.
+Heading laneHeading(int lane)
+{
+  if (lane >= 1 && lane <= 3)
+    return {0.0f, 1.0f}; // 90 degrees, southbound
+  if (lane >= 4 && lane <= 6)
+    return {0.0f, -1.0f}; // 270 degrees, northbound
+  if (lane >= 7 && lane <= 9)
+    return {-1.0f, 0.0f}; // 180 degrees, westbound
+  return {1.0f, 0.0f};    // 0 degrees, eastbound
+}
 
-void socketReceiverThread();
+// Cosine/sine table for arbitrary headings such as the blend between two
+// lane headings during a turn. 4096 steps per turn is under 0.1 degrees,
+// far below what a 40 px car can show.
+class HeadingTable
+{
+public:
+  HeadingTable()
+  {
+    const double step = 2.0 * 3.14159265358979323846 / HEADING_LUT_SIZE;
+    for (int i = 0; i < HEADING_LUT_SIZE; i++)
+      table[i] = {(float)std::cos(i * step), (float)std::sin(i * step)};
+
+    // Keep the quadrant entries exact so the table agrees with laneHeading
+    const int quarter = HEADING_LUT_SIZE / 4;
+    table[0] = {1.0f, 0.0f};
+    table[quarter] = {0.0f, 1.0f};
+    table[2 * quarter] = {-1.0f, 0.0f};
+    table[3 * quarter] = {0.0f, -1.0f};
+  }
 
+  // Any angle in degrees, including negative and above 360
+  Heading fromDegrees(float degrees) const
+  {
+    int index = (int)std::floor(degrees * (HEADING_LUT_SIZE / 360.0f) + 0.5f);
+    return table[index & (HEADING_LUT_SIZE - 1)];
+  }
 
+private:
+  Heading table[HEADING_LUT_SIZE];
+};
 
+const HeadingTable headingTable;
+
+// Structure-of-arrays vehicle storage. The per-frame physics sweep touches
+// only a few fields, so each field lives in its own contiguous array indexed
+// by a dense index. Dense indices change when vehicles are removed; slots
+// go through a slot table and do not, until their vehicle is removed.
+//
+// The store also keeps one persistent list of slots per lane, ordered front
+// to back. Vehicles never overtake within a lane, so the lists only change
+// on spawn, turn completion (changeLane) and removal.
+class VehicleStore
+{
+public:
+  // Hot fields read or written every frame
+  std::vector<float> x, y;
+  std::vector<float> speed; // pixels per second
+
+  // Position at the start of the current step, for render interpolation
+  std::vector<float> prevX, prevY;
+  std::vector<int> lane;
+  std::vector<Uint8> horizontal;
+  std::vector<Uint8> turning;
+
+  // Turn progress; the curve itself lives in TurnSet while turning
+  std::vector<float> t;
+  std::vector<int> targetLane;
+  std::vector<Uint8> targetHorizontal;
+
+  // Cold fields
+  std::vector<int> pathOption;
+  std::vector<SDL_Color> bodyColor;
+  std::vector<Sint8> waitingRoad; // road this vehicle is counted on, -1 if none
+  std::vector<Trip> trip;
+
+  size_t size() const
+  {
+    return x.size();
+  }
 
-// Background thread that listens for incoming vehicle data from generator
-void socketReceiverThread()
+  // Slots in lane, frontmost vehicle first
+  const std::deque<Uint32> &laneOrder(int laneNumber) const
+  {
+    return lanes[laneNumber];
+  }
+
+  size_t denseIndex(Uint32 slot) const
+  {
+    return denseOf[slot];
+  }
+
+  // Vehicles queued before the stop line of a road, maintained incrementally
+  int waitingOnRoad(int road) const
+  {
+    return roadWaiting[road];
+  }
+
+  // Re-evaluates the stop-line counters after a vehicle moved, turned or changed lane
+  void updateWaiting(size_t i)
+  {
+    updateWaitingDeferred(i, roadWaiting);
+  }
+
+  // Same, but adds the counter change to delta[4] instead of the store, so
+  // several lanes can be updated at once and merged with applyWaitingDelta
+  void updateWaitingDeferred(size_t i, int *delta)
+  {
+    int road = waitingRoadFor(lane[i], x[i], y[i], turning[i] != 0);
+    if (road == waitingRoad[i])
+      return;
+    if (waitingRoad[i] >= 0)
+      delta[waitingRoad[i]]--;
+    if (road >= 0)
+      delta[road]++;
+    waitingRoad[i] = (Sint8)road;
+  }
+
+  void applyWaitingDelta(const int *delta)
+  {
+    for (int road = 0; road < 4; road++)
+      roadWaiting[road] += delta[road];
+  }
+
+  // Moves a vehicle to another lane's ordered list at its current position
+  void changeLane(size_t index, int fromLane)
+  {
+    Uint32 slot = slotOf[index];
+    if (fromLane >= 1 && fromLane < MAX_LANES)
+      eraseFromLane(fromLane, slot);
+    insertIntoLane(index);
+  }
+
+  // Snapshots positions before a step so rendering can blend between steps
+  void savePositions()
+  {
+    prevX = x;
+    prevY = y;
+  }
+
+  // Returns the new vehicle's slot
+  Uint32 add(const Vehicle &v)
+  {
+    Uint32 slot;
+    if (!freeSlots.empty())
+    {
+      slot = freeSlots.back();
+      freeSlots.pop_back();
+    }
+    else
+    {
+      slot = (Uint32)denseOf.size();
+      denseOf.push_back(0);
+    }
+    denseOf[slot] = (Uint32)size();
+    slotOf.push_back(slot);
+
+    x.push_back(v.x);
+    y.push_back(v.y);
+    prevX.push_back(v.x);
+    prevY.push_back(v.y);
+    speed.push_back(v.speed);
+    lane.push_back(v.lane);
+    horizontal.push_back(v.horizontal);
+    turning.push_back(v.turning);
+    t.push_back(v.t);
+    targetLane.push_back(v.targetLane);
+    targetHorizontal.push_back(v.targetHorizontal);
+    pathOption.push_back(v.pathOption);
+    bodyColor.push_back(v.bodyColor);
+    waitingRoad.push_back(-1);
+    trip.push_back(v.trip);
+    insertIntoLane(size() - 1);
+    updateWaiting(size() - 1);
+    return slot;
+  }
+
+  // Removes every vehicle matching pred, keeping the rest in their current order
+  template <typename Pred>
+  size_t removeIf(Pred pred)
+  {
+    size_t n = size();
+    size_t w = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+      if (pred(i))
+      {
+        if (lane[i] >= 1 && lane[i] < MAX_LANES)
+          eraseFromLane(lane[i], slotOf[i]);
+        if (waitingRoad[i] >= 0)
+          roadWaiting[waitingRoad[i]]--;
+        freeSlots.push_back(slotOf[i]);
+        continue;
+      }
+      if (w != i)
+        moveElement(i, w);
+      w++;
+    }
+    resizeAll(w);
+    return n - w;
+  }
+
+  Uint32 slotAt(size_t index) const
+  {
+    return slotOf[index];
+  }
+
+  // Assembles an AoS copy for code paths that want the whole vehicle
+  Vehicle get(size_t i) const
+  {
+    Vehicle v;
+    v.x = x[i];
+    v.y = y[i];
+    v.speed = speed[i];
+    v.lane = lane[i];
+    v.pathOption = pathOption[i];
+    v.bodyColor = bodyColor[i];
+    v.active = true;
+    v.horizontal = horizontal[i] != 0;
+    v.turning = turning[i] != 0;
+    v.t = t[i];
+    v.targetLane = targetLane[i];
+    v.targetHorizontal = targetHorizontal[i] != 0;
+    v.trip = trip[i];
+    return v;
+  }
+
+private:
+  std::vector<Uint32> slotOf;      // dense index -> slot
+  std::vector<Uint32> denseOf;     // slot -> dense index
+  std::vector<Uint32> freeSlots;
+  std::deque<Uint32> lanes[MAX_LANES];
+  int roadWaiting[4] = {0, 0, 0, 0};
+
+  // Sorted insert, scanning from the back since new arrivals are usually last
+  void insertIntoLane(size_t index)
+  {
+    int l = lane[index];
+    if (l < 1 || l >= MAX_LANES)
+      return;
+    std::deque<Uint32> &order = lanes[l];
+    size_t pos = order.size();
+    while (pos > 0)
+    {
+      size_t other = denseOf[order[pos - 1]];
+      if (!laneAhead(l, x[index], y[index], x[other], y[other]))
+        break;
+      pos--;
+    }
+    order.insert(order.begin() + pos, slotOf[index]);
+  }
+
+  // Exits happen at the front of a lane, so search from there
+  void eraseFromLane(int l, Uint32 slot)
+  {
+    std::deque<Uint32> &order = lanes[l];
+    auto it = std::find(order.begin(), order.end(), slot);
+    if (it != order.end())
+      order.erase(it);
+  }
+
+  void moveElement(size_t from, size_t to)
+  {
+    x[to] = x[from];
+    y[to] = y[from];
+    prevX[to] = prevX[from];
+    prevY[to] = prevY[from];
+    speed[to] = speed[from];
+    lane[to] = lane[from];
+    horizontal[to] = horizontal[from];
+    turning[to] = turning[from];
+    t[to] = t[from];
+    targetLane[to] = targetLane[from];
+    targetHorizontal[to] = targetHorizontal[from];
+    pathOption[to] = pathOption[from];
+    bodyColor[to] = bodyColor[from];
+    waitingRoad[to] = waitingRoad[from];
+    trip[to] = trip[from];
+    slotOf[to] = slotOf[from];
+    denseOf[slotOf[to]] = (Uint32)to;
+  }
+
+  void resizeAll(size_t n)
+  {
+    x.resize(n);
+    y.resize(n);
+    prevX.resize(n);
+    prevY.resize(n);
+    speed.resize(n);
+    lane.resize(n);
+    horizontal.resize(n);
+    turning.resize(n);
+    t.resize(n);
+    targetLane.resize(n);
+    targetHorizontal.resize(n);
+    pathOption.resize(n);
+    bodyColor.resize(n);
+    waitingRoad.resize(n);
+    trip.resize(n);
+    slotOf.resize(n);
+  }
+};
+
+// Compact structure-of-arrays of the vehicles currently following a turn
+// curve, kept separate from VehicleStore so the Bezier step runs over
+// contiguous arrays and can process several vehicles per SIMD instruction.
+struct TurnSet
 {
-#ifdef _WIN32
-  WSADATA wsaData;
-  if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+  std::vector<float> t, tSpeed;
+  std::vector<float> p0x, p0y, p1x, p1y, p2x, p2y;
+  std::vector<float> outX, outY; // position written by advanceTurns
+  std::vector<Uint32> owner;     // VehicleStore slot
+
+  size_t size() const
   {
-    std::cerr << "WSAStartup failed." << std::endl;
-    return;
+    return t.size();
+  }
+
+  // step is the distance the vehicle covers in one simulation step
+  void add(Uint32 slot, float step, float x0, float y0, float x1, float y1, float x2, float y2)
+  {
+    float dx = x0 - x2;
+    float dy = y0 - y2;
+    float dist = std::sqrt(dx*dx + dy*dy);
+
+    float len = dist * 1.11f;
+    if (len < 1.0f) len = 1.0f;
+
+    t.push_back(0.0f);
+    tSpeed.push_back((step * 3.0f) / len);
+    p0x.push_back(x0);
+    p0y.push_back(y0);
+    p1x.push_back(x1);
+    p1y.push_back(y1);
+    p2x.push_back(x2);
+    p2y.push_back(y2);
+    outX.push_back(x0);
+    outY.push_back(y0);
+    owner.push_back(slot);
+  }
+
+  // Swap-remove; order inside the set carries no meaning
+  void removeAt(size_t k)
+  {
+    size_t last = size() - 1;
+    if (k != last)
+    {
+      t[k] = t[last];
+      tSpeed[k] = tSpeed[last];
+      p0x[k] = p0x[last];
+      p0y[k] = p0y[last];
+      p1x[k] = p1x[last];
+      p1y[k] = p1y[last];
+      p2x[k] = p2x[last];
+      p2y[k] = p2y[last];
+      outX[k] = outX[last];
+      outY[k] = outY[last];
+      owner[k] = owner[last];
+    }
+    t.pop_back();
+    tSpeed.pop_back();
+    p0x.pop_back();
+    p0y.pop_back();
+    p1x.pop_back();
+    p1y.pop_back();
+    p2x.pop_back();
+    p2y.pop_back();
+    outX.pop_back();
+    outY.pop_back();
+    owner.pop_back();
+  }
+};
+
+// Advances turns [begin, end) one step: t += tSpeed (clamped to 1) and
+// out = (1-t)^2 p0 + 2(1-t)t p1 + t^2 p2. The SIMD paths use the same
+// operation order as this one so all three produce identical results.
+void advanceTurnsScalar(TurnSet &ts, size_t begin, size_t end)
+{
+  for (size_t k = begin; k < end; k++)
+  {
+    float t = ts.t[k] + ts.tSpeed[k];
+    if (t > 1.0f) t = 1.0f;
+    float u = 1.0f - t;
+    float tt = t * t;
+    float uu = u * u;
+    float ut2 = 2 * u * t;
+    ts.t[k] = t;
+    ts.outX[k] = uu * ts.p0x[k] + ut2 * ts.p1x[k] + tt * ts.p2x[k];
+    ts.outY[k] = uu * ts.p0y[k] + ut2 * ts.p1y[k] + tt * ts.p2y[k];
+  }
+}
+
+#if defined(__AVX2__) || defined(__AVX__)
+#define TURN_SIMD_NAME "AVX"
+#define TURN_SIMD_WIDTH 8
+void advanceTurnsSimd(TurnSet &ts)
+{
+  size_t n = ts.size();
+  size_t k = 0;
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 two = _mm256_set1_ps(2.0f);
+  for (; k + 8 <= n; k += 8)
+  {
+    __m256 t = _mm256_min_ps(_mm256_add_ps(_mm256_loadu_ps(&ts.t[k]), _mm256_loadu_ps(&ts.tSpeed[k])), one);
+    __m256 u = _mm256_sub_ps(one, t);
+    __m256 tt = _mm256_mul_ps(t, t);
+    __m256 uu = _mm256_mul_ps(u, u);
+    __m256 ut2 = _mm256_mul_ps(_mm256_mul_ps(two, u), t);
+    _mm256_storeu_ps(&ts.t[k], t);
+    __m256 x = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(uu, _mm256_loadu_ps(&ts.p0x[k])),
+                                           _mm256_mul_ps(ut2, _mm256_loadu_ps(&ts.p1x[k]))),
+                             _mm256_mul_ps(tt, _mm256_loadu_ps(&ts.p2x[k])));
+    __m256 y = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(uu, _mm256_loadu_ps(&ts.p0y[k])),
+                                           _mm256_mul_ps(ut2, _mm256_loadu_ps(&ts.p1y[k]))),
+                             _mm256_mul_ps(tt, _mm256_loadu_ps(&ts.p2y[k])));
+    _mm256_storeu_ps(&ts.outX[k], x);
+    _mm256_storeu_ps(&ts.outY[k], y);
+  }
+  advanceTurnsScalar(ts, k, n);
+}
+#elif defined(__SSE2__) || defined(_M_X64)
+#define TURN_SIMD_NAME "SSE2"
+#define TURN_SIMD_WIDTH 4
+void advanceTurnsSimd(TurnSet &ts)
+{
+  size_t n = ts.size();
+  size_t k = 0;
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 two = _mm_set1_ps(2.0f);
+  for (; k + 4 <= n; k += 4)
+  {
+    __m128 t = _mm_min_ps(_mm_add_ps(_mm_loadu_ps(&ts.t[k]), _mm_loadu_ps(&ts.tSpeed[k])), one);
+    __m128 u = _mm_sub_ps(one, t);
+    __m128 tt = _mm_mul_ps(t, t);
+    __m128 uu = _mm_mul_ps(u, u);
+    __m128 ut2 = _mm_mul_ps(_mm_mul_ps(two, u), t);
+    _mm_storeu_ps(&ts.t[k], t);
+    __m128 x = _mm_add_ps(_mm_add_ps(_mm_mul_ps(uu, _mm_loadu_ps(&ts.p0x[k])),
+                                     _mm_mul_ps(ut2, _mm_loadu_ps(&ts.p1x[k]))),
+                          _mm_mul_ps(tt, _mm_loadu_ps(&ts.p2x[k])));
+    __m128 y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(uu, _mm_loadu_ps(&ts.p0y[k])),
+                                     _mm_mul_ps(ut2, _mm_loadu_ps(&ts.p1y[k]))),
+                          _mm_mul_ps(tt, _mm_loadu_ps(&ts.p2y[k])));
+    _mm_storeu_ps(&ts.outX[k], x);
+    _mm_storeu_ps(&ts.outY[k], y);
   }
+  advanceTurnsScalar(ts, k, n);
+}
+#else
+#define TURN_SIMD_NAME "scalar"
+#define TURN_SIMD_WIDTH 1
+void advanceTurnsSimd(TurnSet &ts)
+{
+  advanceTurnsScalar(ts, 0, ts.size());
+}
 #endif
 
-  SOCKET server_fd, new_socket;
-  struct sockaddr_in address;
-  int addrlen = sizeof(address);
-  char buffer[BUFFER_SIZE] = {0};
+// Times the scalar and SIMD turn kernels on synthetic curves (--bench-turns)
+int runTurnBenchmark()
+{
+  const size_t counts[] = {1000, 10000, 100000};
+  std::cout << "Turn kernel benchmark (" << TURN_SIMD_NAME << ", " << TURN_SIMD_WIDTH << " lanes)" << std::endl;
 
-  if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+  for (size_t count : counts)
   {
-    perror("Socket failed");
-    return;
+    TurnSet ts;
+    for (size_t k = 0; k < count; k++)
+    {
+      float a = (float)(k % 360);
+      ts.add((Uint32)k, 2.0f, 300.0f + a * 0.1f, 300.0f, 400.0f, 350.0f + a * 0.05f, 500.0f, 400.0f - a * 0.1f);
+      ts.tSpeed[k] = 1e-6f * (float)(1 + k % 7); // stay below t = 1 for the whole run
+    }
+    TurnSet simd = ts;
+
+    size_t iterations = std::max<size_t>(10, 20000000 / count);
+    auto timeKernel = [&](TurnSet &set, bool useSimd) -> double {
+      auto start = std::chrono::steady_clock::now();
+      for (size_t it = 0; it < iterations; it++)
+      {
+        if (useSimd)
+          advanceTurnsSimd(set);
+        else
+          advanceTurnsScalar(set, 0, set.size());
+      }
+      double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+      return ns / ((double)iterations * (double)count);
+    };
+
+    double scalarNs = timeKernel(ts, false);
+    double simdNs = timeKernel(simd, true);
+    bool identical = ts.outX == simd.outX && ts.outY == simd.outY && ts.t == simd.t;
+
+    std::printf("  %7zu turning: scalar %.3f ns/vehicle, %s %.3f ns/vehicle, speedup %.2fx, results %s\n",
+                count, scalarNs, TURN_SIMD_NAME, simdNs, scalarNs / simdNs, identical ? "identical" : "DIFFER");
   }
+  return 0;
+}
 
-  address.sin_family = AF_INET;
-  address.sin_addr.s_addr = INADDR_ANY;
-  address.sin_port = htons(PORT);
+Uint64 totalSpawned = 0;
+Uint64 totalExited = 0;
+Uint32 simTimeMs = 0; // simulated time, advanced only by simulationStep
+Uint32 simTick = 0;   // steps taken so far
+
+// Everything random in the simulation draws from these, so a seed plus the
+// tick of every arrival reproduces a run exactly
+Uint64 simSeed = 0;
+Pcg32 colorRng(0, 1);   // vehicle body colors
+Pcg32 arrivalRng(0, 2); // headless synthetic arrivals
+
+// Replay recording and playback
+ReplayWriter replayRecorder;
+ReplayReader replaySource;
+bool replaying = false;
+bool hasPendingReplay = false;
+ReplayRecord pendingReplay;                // next record not yet due
+std::deque<ReplayRecord> expectedLights;   // recorded light changes due this step
+Uint64 replayDivergences = 0;
+
+// State of the adaptive traffic light controller
+struct LightController
+{
+  Uint32 lastLightSwitchTime;
+  int lightPhase;
+  int targetPhase;
+  bool isTransitioning;
+  int priorityLane;
+};
+
+// Command line options for running without a window
+struct HeadlessOptions
+{
+  bool enabled;
+  double durationSeconds;   // 0 runs until killed
+  double arrivalsPerSecond; // built-in random arrivals on top of the generator
+  double timeScale;         // simulated seconds per wall second, 0 runs flat out
+  bool listen;              // accept a Traffic Generator connection
+};
+
+#define DEFAULT_LINK_LENGTH 200 // pixels of road between an exit box edge and the next entry
+#define MAX_INTERSECTIONS 65535 // ids are 16-bit in the replay log
+#define EXIT_MARGIN 100.0f      // vehicles leave an intersection this far outside its 800x800 frame
+
+// Sides of an intersection, numbered like the roads that approach from them:
+// road A comes from the north, B from the south, C from the east, D from the west
+#define SIDE_NORTH 0
+#define SIDE_SOUTH 1
+#define SIDE_EAST 2
+#define SIDE_WEST 3
+
+// A vehicle leaving an intersection this step
+struct ExitingVehicle
+{
+  int side;
+  SDL_Color bodyColor;
+  Trip trip;
+};
+
+// A vehicle driving along a link towards its next intersection
+struct LinkVehicle
+{
+  Uint32 arrivalTick;
+  SDL_Color bodyColor;
+  Trip trip;
+};
+
+// Directed road from one side of an intersection to the opposite side of a
+// neighbor. Vehicles on it are not simulated, only delayed by the travel time;
+// all move at the same speed, so the queue stays ordered by arrival. The
+// queue belongs to the region of `to`.
+struct Link
+{
+  int from, to;
+  int entryRoad; // road of `to` the vehicles arrive on
+  Uint32 travelSteps;
+  std::deque<LinkVehicle> inTransit;
+  int mailbox; // mailbox into the region of `to`, -1 if both ends share a region, LINK_REMOTE
+};
+
+#define LINK_REMOTE -2 // `to` belongs to another process of a cluster run
+
+// A vehicle posted to another region's link
+struct Handoff
+{
+  int link;
+  LinkVehicle vehicle;
+};
+
+// One-way mailbox between two neighboring regions, double-buffered by tick
+// parity: the sender fills one side during a step while the receiver empties
+// the side filled on the previous step, so neither side needs a lock. Every
+// link takes at least one step to drive, so the one step delay is never seen.
+struct Mailbox
+{
+  int from, to;
+  std::vector<Handoff> slots[2];
+};
+
+// Block of consecutive intersection ids stepped by one job. Ids run row by
+// row, so a region is a band of the grid and only borders a few others.
+struct Region
+{
+  int first, last; // intersections [first, last)
+  std::vector<int> inbox; // mailboxes this region receives from
+  std::vector<int> lightChanges; // intersections whose signal changed this step, in id order
+  Uint64 exited;   // vehicles that left the network this step
+  Uint64 handoffs; // vehicles that arrived over a link this step
+  std::vector<Handoff> exports; // vehicles bound for other processes, sent at the end of the epoch
+  LatencyHistogram stoppedTime;  // per vehicle leaving the network, simulated
+  LatencyHistogram networkTime;  // spawn to leaving the network, simulated
+};
+
+// A turn started during the lane sweep, added to the TurnSet when lanes merge
+struct PendingTurn
+{
+  Uint32 slot;
+  float step;
+  float x0, y0, x1, y1, x2, y2;
+};
+
+// Side effects of sweeping one lane, kept apart so lanes can run in parallel
+struct LaneWork
+{
+  int waitingDelta[4];
+  std::vector<PendingTurn> turns;
+
+  void reset()
+  {
+    for (int road = 0; road < 4; road++)
+      waitingDelta[road] = 0;
+    turns.clear();
+  }
+};
+
+// One copy of the original crossing. Vehicles live in the intersection's own
+// 800x800 frame, exactly as in the single-intersection simulator; placement
+// in the network only matters when a vehicle is handed over a link.
+struct Intersection
+{
+  int id;
+  int row, col;
+  VehicleStore vehicles;
+  TurnSet turns;
+  LightController lights;
+  int signal;     // phase shown to vehicles: 0 all red while switching, 1-4 green road
+  int lastSignal; // last phase seen by trackLightPhase
+  int exitLink[4];  // link leaving through each side, -1 at the edge of the network
+  int entryLink[4]; // link arriving on each side, -1 at the edge of the network
+  int inbound;      // vehicles queued on the entry links
+  Pcg32 rng;        // lane and path of vehicles arriving over links
+
+  // Scratch reused by updateVehicles
+  std::vector<Uint32> laneGroups[MAX_LANES];
+  std::vector<Uint32> completedTurns;
+  LaneWork laneWork[MAX_LANES];
+  std::vector<ExitingVehicle> exits;
+
+  Intersection(int index, int r, int c, Uint64 seed)
+      : id(index), row(r), col(c), lights{0, 1, 1, false, -1}, signal(0), lastSignal(-1),
+        exitLink{-1, -1, -1, -1}, entryLink{-1, -1, -1, -1}, inbound(0), rng(seed, 16 + (Uint64)index)
+  {
+  }
+};
+
+// Where external traffic (generator, synthetic, replay) can enter
+struct EntryPoint
+{
+  int intersection;
+  int lane;
+};
+
+// Grid of intersections joined by links. Per-step cost is one light update
+// per intersection plus work proportional to the vehicles on the network:
+// empty intersections skip the vehicle sweep and links are only visited
+// while they carry vehicles.
+//
+// The grid is split into regions that step in parallel. An intersection
+// only reads its own state and its entry links during a step, and vehicles
+// crossing into another region go through a Mailbox, so the outcome does not
+// depend on how many regions or threads there are.
+class RoadNetwork
+{
+public:
+  std::vector<Intersection> intersections;
+  std::vector<Link> links;
+  std::vector<Region> regions;
+  std::vector<Mailbox> mailboxes;
+  std::vector<EntryPoint> entries;
+  std::vector<int> boundary[4]; // intersections whose side has no neighbor, per side
+  int cols = 0, rows = 0;
+  int linkLength = DEFAULT_LINK_LENGTH;
+  int ownedFirst = 0, ownedLast = 0; // intersections this process steps
+
+  void buildGrid(int gridCols, int gridRows, int length, Uint64 seed)
+  {
+    static const int entryLanes[] = {2, 3, 4, 5, 8, 9, 10, 11};
+    cols = gridCols;
+    rows = gridRows;
+    linkLength = length;
+    intersections.clear();
+    links.clear();
+    entries.clear();
+    for (int side = 0; side < 4; side++)
+      boundary[side].clear();
+
+    intersections.reserve((size_t)cols * rows);
+    for (int r = 0; r < rows; r++)
+      for (int c = 0; c < cols; c++)
+        intersections.emplace_back((int)intersections.size(), r, c, seed);
+
+    // Travel from the exit margin of one frame to the spawn point of the next
+    Uint32 steps = (Uint32)std::ceil((length + EXIT_MARGIN + 50.0f) / (VEHICLE_SPEED * SIM_DT));
+    for (int id = 0; id < (int)intersections.size(); id++)
+    {
+      for (int side = 0; side < 4; side++)
+      {
+        int neighbor = neighborOf(id, side);
+        if (neighbor < 0)
+        {
+          boundary[side].push_back(id);
+          continue;
+        }
+        Link link;
+        link.from = id;
+        link.to = neighbor;
+        link.entryRoad = oppositeSide(side);
+        link.travelSteps = steps;
+        link.mailbox = -1;
+        intersections[id].exitLink[side] = (int)links.size();
+        intersections[neighbor].entryLink[link.entryRoad] = (int)links.size();
+        links.push_back(link);
+      }
+
+      for (int lane : entryLanes)
+      {
+        if (neighborOf(id, roadOfLane(lane)) < 0)
+          entries.push_back({id, lane});
+      }
+    }
+    partition(0, (int)intersections.size(), 1);
+  }
+
+  // First id of band k when count ids are split into parts bands
+  static int bandStart(int count, int parts, int k)
+  {
+    return (int)((long long)count * k / parts);
+  }
+
+  // Makes this process step intersections [first, last), split into up to
+  // regionCount bands, and sets up a mailbox for every pair of regions
+  // joined by a link. Links leaving the range are marked LINK_REMOTE.
+  void partition(int first, int last, int regionCount)
+  {
+    int n = last - first;
+    ownedFirst = first;
+    ownedLast = last;
+    regionCount = std::max(1, std::min(regionCount, n));
+    regions.assign(regionCount, Region());
+    mailboxes.clear();
+    std::vector<int> regionOf(intersections.size(), -1);
+    for (int k = 0; k < regionCount; k++)
+    {
+      Region &region = regions[k];
+      region.first = first + bandStart(n, regionCount, k);
+      region.last = first + bandStart(n, regionCount, k + 1);
+      region.exited = 0;
+      region.handoffs = 0;
+      for (int id = region.first; id < region.last; id++)
+        regionOf[id] = k;
+    }
+
+    for (Link &link : links)
+    {
+      int from = regionOf[link.from], to = regionOf[link.to];
+      link.mailbox = -1;
+      if (from < 0 || from == to)
+        continue;
+      if (to < 0)
+      {
+        link.mailbox = LINK_REMOTE;
+        continue;
+      }
+      for (int m : regions[to].inbox)
+      {
+        if (mailboxes[m].from == from)
+          link.mailbox = m;
+      }
+      if (link.mailbox < 0)
+      {
+        link.mailbox = (int)mailboxes.size();
+        mailboxes.push_back(Mailbox());
+        mailboxes.back().from = from;
+        mailboxes.back().to = to;
+        regions[to].inbox.push_back(link.mailbox);
+      }
+    }
+  }
+
+  // Intersection beyond the given side, or -1
+  int neighborOf(int id, int side) const
+  {
+    int r = id / cols, c = id % cols;
+    switch (side)
+    {
+    case SIDE_NORTH:
+      r--;
+      break;
+    case SIDE_SOUTH:
+      r++;
+      break;
+    case SIDE_EAST:
+      c++;
+      break;
+    default:
+      c--;
+      break;
+    }
+    if (r < 0 || r >= rows || c < 0 || c >= cols)
+      return -1;
+    return r * cols + c;
+  }
+
+  static int oppositeSide(int side)
+  {
+    return side ^ 1;
+  }
+
+  // Road (0-3) a lane approaches on
+  static int roadOfLane(int lane)
+  {
+    if (lane >= 1 && lane <= 3)
+      return 0;
+    if (lane >= 4 && lane <= 6)
+      return 1;
+    if (lane >= 7 && lane <= 9)
+      return 2;
+    return 3;
+  }
+
+  bool owns(int id) const
+  {
+    return id >= ownedFirst && id < ownedLast;
+  }
+
+  // Boundary intersection an external vehicle on this lane enters; spread
+  // by id so a generator feeds every edge intersection of a side
+  int entryIntersection(int lane, Uint32 vehicleId) const
+  {
+    const std::vector<int> &edge = boundary[roadOfLane(lane)];
+    return edge[vehicleId % edge.size()];
+  }
+
+  // Called by the sending region; a link into another region goes through
+  // its mailbox, one into another process waits for the end of the epoch
+  void sendOverLink(Region &region, int linkIndex, Uint32 tick, const ExitingVehicle &exit)
+  {
+    Link &link = links[linkIndex];
+    LinkVehicle vehicle = {tick + link.travelSteps, exit.bodyColor, exit.trip};
+    if (link.mailbox == LINK_REMOTE)
+      region.exports.push_back({linkIndex, vehicle});
+    else if (link.mailbox < 0)
+      enterLink(linkIndex, vehicle);
+    else
+      mailboxes[link.mailbox].slots[tick & 1].push_back({linkIndex, vehicle});
+  }
+
+  // Called by the receiving region
+  void enterLink(int linkIndex, const LinkVehicle &vehicle)
+  {
+    Link &link = links[linkIndex];
+    link.inTransit.push_back(vehicle);
+    intersections[link.to].inbound++;
+  }
+
+  // Empties the mailboxes filled during the previous step into the links
+  void collectMail(const Region &region, Uint32 tick)
+  {
+    for (int m : region.inbox)
+    {
+      std::vector<Handoff> &mail = mailboxes[m].slots[(tick - 1) & 1];
+      for (const Handoff &handoff : mail)
+        enterLink(handoff.link, handoff.vehicle);
+      mail.clear();
+    }
+  }
+
+  size_t vehiclesInTransit() const
+  {
+    size_t n = 0;
+    for (const Intersection &ix : intersections)
+      n += ix.inbound;
+    for (const Mailbox &mailbox : mailboxes)
+      n += mailbox.slots[0].size() + mailbox.slots[1].size();
+    for (const Region &region : regions)
+      n += region.exports.size();
+    return n;
+  }
+
+  size_t vehiclesInIntersections() const
+  {
+    size_t n = 0;
+    for (const Intersection &ix : intersections)
+      n += ix.vehicles.size();
+    return n;
+  }
+};
+
+RoadNetwork network;
+JobSystem jobs;
+int viewIntersection = 0; // intersection shown in the window
+Uint64 totalHandoffs = 0;
+
+// This process as one worker of a distributed run (see cluster.h)
+struct ClusterWorker
+{
+  bool enabled = false;
+  int rank = 0;
+  int workers = 1;
+  const char *host = "127.0.0.1";
+  int port = DEFAULT_CLUSTER_PORT;
+  SOCKET socket = (SOCKET)-1;
+  Uint32 epochTicks = 0; // steps between exchanges, at most the link travel time
+  FrameDecoder decoder;
+  std::vector<uint8_t> out;
+  std::vector<std::vector<HandoffRecord>> outgoing; // per destination rank
+  Uint64 epochs = 0;
+  Uint64 exported = 0;
+  Uint64 imported = 0;
+};
+
+ClusterWorker cluster;
+
+// Rendered text textures keyed by font, color and string. Static labels are
+// rasterized and uploaded once; changing HUD text (counters, timings) reuses
+// its textures while the value repeats and evicts the least recently used
+// entry once the cache is full.
+class TextCache
+{
+public:
+  // Draws text with its top-left corner at (x, y)
+  void draw(SDL_Renderer *renderer, TTF_Font *font, const char *text, float x, float y, SDL_Color color)
+  {
+    Entry *entry = lookup(renderer, font, text, color);
+    if (!entry)
+      return;
+    SDL_FRect rect = {x, y, entry->w, entry->h};
+    SDL_RenderTexture(renderer, entry->texture, NULL, &rect);
+  }
+
+  // Size text would be drawn at, for layout; false if it cannot be rendered
+  bool measure(SDL_Renderer *renderer, TTF_Font *font, const char *text, SDL_Color color, float &w, float &h)
+  {
+    Entry *entry = lookup(renderer, font, text, color);
+    if (!entry)
+      return false;
+    w = entry->w;
+    h = entry->h;
+    return true;
+  }
+
+  // Destroys every texture; call before the renderer or a font goes away
+  void clear()
+  {
+    for (auto &item : entries)
+      SDL_DestroyTexture(item.second.texture);
+    entries.clear();
+  }
+
+private:
+  struct Entry
+  {
+    SDL_Texture *texture;
+    float w, h;
+    Uint64 lastUse;
+  };
+
+  std::unordered_map<std::string, Entry> entries;
+  std::string key;
+  Uint64 useCounter = 0;
+
+  Entry *lookup(SDL_Renderer *renderer, TTF_Font *font, const char *text, SDL_Color color)
+  {
+    if (!font || !text || !*text)
+      return nullptr;
+
+    // Font pointer and color prefix the string so equal text in another style gets its own texture
+    key.assign((const char *)&font, sizeof(font));
+    key.append((const char *)&color, sizeof(color));
+    key.append(text);
+
+    auto it = entries.find(key);
+    if (it != entries.end())
+    {
+      it->second.lastUse = ++useCounter;
+      return &it->second;
+    }
+
+    SDL_Surface *surface = TTF_RenderText_Solid(font, text, strlen(text), color);
+    if (!surface)
+    {
+      SDL_Log("TTF_RenderText_Solid failed: %s", SDL_GetError());
+      return nullptr;
+    }
+    SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
+    SDL_DestroySurface(surface);
+    if (!texture)
+    {
+      SDL_Log("SDL_CreateTextureFromSurface failed: %s", SDL_GetError());
+      return nullptr;
+    }
+
+    if (entries.size() >= TEXT_CACHE_MAX_ENTRIES)
+      evictOldest();
+
+    Entry entry = {texture, 0.0f, 0.0f, ++useCounter};
+    SDL_GetTextureSize(texture, &entry.w, &entry.h);
+    return &entries.emplace(key, entry).first->second;
+  }
+
+  void evictOldest()
+  {
+    auto oldest = entries.begin();
+    for (auto it = entries.begin(); it != entries.end(); ++it)
+    {
+      if (it->second.lastUse < oldest->second.lastUse)
+        oldest = it;
+    }
+    SDL_DestroyTexture(oldest->second.texture);
+    entries.erase(oldest);
+  }
+};
+
+TextCache textCache;
+
+// Roads, markings and labels never change, so they are drawn once into this
+// render target and blitted every frame. Rebuilt when the output size changes
+// or the renderer loses its targets.
+SDL_Texture *backgroundTexture = nullptr;
+
+// Every vehicle quad of a frame, submitted with one SDL_RenderGeometry call.
+// Vertices are refilled each frame; both vectors keep their capacity, and
+// the index pattern is only extended when the vehicle count grows.
+struct VehicleBatch
+{
+  std::vector<SDL_Vertex> vertices;
+  std::vector<int> indices;
+};
+
+VehicleBatch vehicleBatch;
+
+bool initializeSDL(SDL_Window **window, SDL_Renderer **renderer);
+void drawRoadsAndLane(SDL_Renderer *renderer, TTF_Font *font, float alpha);
+void drawStaticScene(SDL_Renderer *renderer, TTF_Font *font);
+bool buildBackground(SDL_Renderer *renderer, TTF_Font *font);
+void invalidateBackground();
+void displayText(SDL_Renderer *renderer, TTF_Font *font, const char *text, int x, int y);
+void trackViewLight();
+void drawLightForB(SDL_Renderer *renderer, bool isRed);
+void drawArrow(SDL_Renderer *renderer, int x1, int y1, int x2, int y2, int x3, int y3);
+
+void drawLightForA(SDL_Renderer *renderer, bool isRed);
+void drawLightForB(SDL_Renderer *renderer, bool isRed);
+void drawLightForC(SDL_Renderer *renderer, bool isRed);
+void drawLightForD(SDL_Renderer *renderer, bool isRed);
+
+void drawTrafficLight(SDL_Renderer *renderer, float x, float y, bool isRed, bool horizontal);
+
+void batchCar(VehicleBatch &batch, const Vehicle &v);
+void flushVehicleBatch(SDL_Renderer *renderer, VehicleBatch &batch);
+
+bool isEntryLane(int lane);
+bool spawnVehicle(Intersection &ix, int lane, int pathOption, SDL_Color color, const Trip &trip);
+void spawnArrival(int intersection, int lane, int pathOption);
+void updateVehicles(Intersection &ix);
+
+void socketReceiverThread();
+SOCKET openListener(const char *host, int port, int backlog);
+bool sendAll(SOCKET s, const uint8_t *data, size_t length);
+bool recvFrame(SOCKET s, FrameDecoder &decoder, uint8_t &type, const uint8_t *&payload, uint16_t &length);
+
+double steadyNowMs();
+int countVehiclesOnRoad(const Intersection &ix, int roadIndex);
+void processIncomingVehicles();
+void printIngestStats();
+void printLatencyReport();
+void updateTrafficLights(Intersection &ix, Uint32 currentTime);
+void simulationStep();
+void stepRegion(Region &region);
+int deliverLinkArrivals(Intersection &ix);
+void playbackArrivals();
+bool replayDone();
+void trackLightPhase(Intersection &ix);
+void checkMissedLights();
+void finishReplay();
+bool parseTimeScale(const char *text, double &scale);
+bool parseGrid(const char *text, int &cols, int &rows);
+int clusterRankOf(int id);
+bool joinCluster(Uint32 ticks);
+bool exchangeBoundary();
+void leaveCluster();
+int runCoordinator(const char *host, int workers, int port);
+int runHeadless(const HeadlessOptions &opts);
+
+// Background thread that listens for incoming vehicle data from generator
+void socketReceiverThread()
+{
+#ifdef _WIN32
+  WSADATA wsaData;
+  if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+  {
+    logWrite(LOG_ERROR, "WSAStartup failed.");
+    return;
+  }
+#endif
+
+  SOCKET server_fd, new_socket;
+  struct sockaddr_in address;
+  int addrlen = sizeof(address);
+  char buffer[BUFFER_SIZE];
+  FrameDecoder decoder;
+
+  if ((server_fd = openListener(nullptr, PORT, 3)) == -1)
+    return;
+
+  logWrite(LOG_INFO, "Server listening on port %d...", PORT);
+
+  if ((new_socket = accept(server_fd, (struct sockaddr *)&address, (socklen_t *)&addrlen)) == -1)
+  {
+    perror("Accept failed");
+    closesocket(server_fd);
+    return;
+  }
+
+  logWrite(LOG_INFO, "Client connected (Traffic Generator)...");
+
+  while (true)
+  {
+    int bytes_read = recv(new_socket, buffer, BUFFER_SIZE, 0);
+
+    if (bytes_read > 0)
+    {
+      decoder.feed(buffer, bytes_read);
+
+      double receivedMs = steadyNowMs();
+      Uint64 receivedStep = stepCounter.load(std::memory_order_relaxed);
+      VehicleMessage msg;
+      while (decoder.next(msg))
+      {
+        IncomingVehicle incoming;
+        incoming.vehicleId = (int)msg.vehicleId;
+        incoming.lane = msg.lane;
+        incoming.pathOption = msg.pathOption;
+        incoming.generatedUs = msg.generatedUs;
+        incoming.sentUs = msg.sentUs;
+        incoming.receivedMs = receivedMs;
+        incoming.receivedStep = receivedStep;
+
+        if (!vehicleRing.push(incoming))
+          logWrite(LOG_WARN, "Ingest ring full, dropped vehicle #%d (Dropped so far: %llu)",
+                   incoming.vehicleId, (unsigned long long)vehicleRing.getOverflowCount());
+        else if (logEnabled(LOG_VEHICLE))
+          logWrite(LOG_VEHICLE, "Received vehicle #%d lane %d (Queue size: %llu)",
+                   incoming.vehicleId, incoming.lane, (unsigned long long)vehicleRing.size());
+      }
+    }
+    else if (bytes_read == 0)
+    {
+      logWrite(LOG_INFO, "Client disconnected.");
+      break;
+    }
+    else
+    {
+      perror("recv failed");
+      break;
+    }
+  }
+
+  if (decoder.getBadBytes() > 0)
+    logWrite(LOG_WARN, "Discarded %llu malformed bytes from generator", (unsigned long long)decoder.getBadBytes());
+
+  closesocket(new_socket);
+  closesocket(server_fd);
+#ifdef _WIN32
+  WSACleanup();
+#endif
+}
+
+// TCP socket listening on host (every interface if null), or -1 after
+// reporting why not
+SOCKET openListener(const char *host, int port, int backlog)
+{
+  SOCKET server_fd;
+  struct sockaddr_in address;
+
+  if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+  {
+    perror("Socket failed");
+    return (SOCKET)-1;
+  }
+
+  // Lets a restarted run take the port over without waiting for TIME_WAIT
+  int reuse = 1;
+  setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, (const char *)&reuse, sizeof(reuse));
+
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = INADDR_ANY;
+  address.sin_port = htons(port);
+  if (host && inet_pton(AF_INET, host, &address.sin_addr) <= 0)
+  {
+    logWrite(LOG_ERROR, "Invalid listen address %s", host);
+    closesocket(server_fd);
+    return (SOCKET)-1;
+  }
+
+  if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) == -1)
+  {
+    perror("Bind failed");
+    closesocket(server_fd);
+    return (SOCKET)-1;
+  }
+
+  if (listen(server_fd, backlog) < 0)
+  {
+    perror("Listen failed");
+    closesocket(server_fd);
+    return (SOCKET)-1;
+  }
+  return server_fd;
+}
+
+// Cluster traffic is small messages waiting on each other, so send at once
+void setNoDelay(SOCKET s)
+{
+  int noDelay = 1;
+  setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char *)&noDelay, sizeof(noDelay));
+}
+
+bool sendAll(SOCKET s, const uint8_t *data, size_t length)
+{
+  while (length > 0)
+  {
+    int sent = send(s, (const char *)data, (int)std::min(length, (size_t)65536), 0);
+    if (sent <= 0)
+    {
+      perror("send failed");
+      return false;
+    }
+    data += sent;
+    length -= (size_t)sent;
+  }
+  return true;
+}
+
+// Blocks until the next complete message arrives; false once the peer is gone
+bool recvFrame(SOCKET s, FrameDecoder &decoder, uint8_t &type, const uint8_t *&payload, uint16_t &length)
+{
+  char buffer[BUFFER_SIZE];
+  while (!decoder.nextFrame(type, payload, length))
+  {
+    int bytes_read = recv(s, buffer, BUFFER_SIZE, 0);
+    if (bytes_read <= 0)
+    {
+      if (bytes_read < 0)
+        perror("recv failed");
+      return false;
+    }
+    decoder.feed(buffer, bytes_read);
+  }
+  return true;
+}
+
+// Non-turning vehicles waiting before the stop line of a road; O(1), the
+// store updates the counters as vehicles cross the thresholds
+int countVehiclesOnRoad(const Intersection &ix, int roadIndex)
+{
+  return ix.vehicles.waitingOnRoad(roadIndex);
+}
+
+double steadyNowMs()
+{
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Drains the network ring (up to ingestBudget) and spawns every pending
+// vehicle. Runs once per simulation step, so the budget and the lag count
+// steps rather than rendered frames
+void processIncomingVehicles()
+{
+  Uint64 step = stepCounter.fetch_add(1, std::memory_order_relaxed);
+  double now = steadyNowMs();
+  Sint64 nowUs = (Sint64)(now * 1000.0);
+  size_t batch = 0;
+
+  IncomingVehicle incoming;
+  while ((ingestBudget == 0 || batch < ingestBudget) && vehicleRing.pop(incoming))
+  {
+    spawnArrival(network.entryIntersection(incoming.lane, incoming.vehicleId), incoming.lane, incoming.pathOption);
+    batch++;
+
+    double lagMs = now - incoming.receivedMs;
+    // Steps waited beyond the next one, so 0 means this step was the first
+    // that could see it. The receiver may stamp the counter just after this
+    // step claimed it, which also counts as 0
+    Uint64 lagSteps = step > incoming.receivedStep ? step - incoming.receivedStep : 0;
+    ingestStats.totalLagMs += lagMs;
+    ingestStats.totalLagSteps += lagSteps;
+    ingestStats.maxLagMs = std::max(ingestStats.maxLagMs, lagMs);
+    ingestStats.maxLagSteps = std::max(ingestStats.maxLagSteps, lagSteps);
+
+    // The generator stamps with its steady clock, which only matches ours
+    // when both run on the same host
+    if (incoming.sentUs > 0)
+    {
+      generatorQueueLatency.recordSigned(incoming.sentUs - incoming.generatedUs);
+      ingestLatency.recordSigned(nowUs - incoming.sentUs);
+    }
+  }
+
+  if (batch > 0)
+  {
+    ingestStats.spawned += batch;
+    ingestStats.batches++;
+    ingestStats.largestBatch = std::max(ingestStats.largestBatch, batch);
+  }
+}
+
+void printIngestStats()
+{
+  if (ingestStats.spawned == 0)
+  {
+    std::cout << "Ingest: no vehicles received" << std::endl;
+    return;
+  }
+  std::cout << "Ingest: " << ingestStats.spawned << " vehicles in " << ingestStats.batches
+            << " batches (largest " << ingestStats.largestBatch << "), lag avg "
+            << ingestStats.totalLagMs / ingestStats.spawned << " ms / "
+            << (double)ingestStats.totalLagSteps / ingestStats.spawned << " steps, max "
+            << ingestStats.maxLagMs << " ms / " << ingestStats.maxLagSteps << " steps" << std::endl;
+}
+
+// Percentiles of generator vehicles in wall time and of finished trips in
+// simulated time, optionally exported in full
+void printLatencyReport()
+{
+  LatencyHistogram stopped, trips;
+  for (const Region &region : network.regions)
+  {
+    stopped.merge(region.stoppedTime);
+    trips.merge(region.networkTime);
+  }
+
+  std::cout << "Latency:" << std::endl;
+  generatorQueueLatency.print(stdout, "  generator queue");
+  ingestLatency.print(stdout, "  ingest lag");
+  stopped.print(stdout, "  stop-line wait (sim)");
+  trips.print(stdout, "  time in network (sim)");
+  fflush(stdout);
+
+  if (!latencyReportPath)
+    return;
+  FILE *report = fopen(latencyReportPath, "w");
+  if (!report)
+  {
+    perror("Failed to open latency report");
+    return;
+  }
+  generatorQueueLatency.exportDistribution(report, "generator queue (wall ms)");
+  ingestLatency.exportDistribution(report, "ingest lag (wall ms)");
+  stopped.exportDistribution(report, "stop-line wait (simulated ms)");
+  trips.exportDistribution(report, "time in network (simulated ms)");
+  fclose(report);
+  std::cout << "Latency distributions written to " << latencyReportPath << std::endl;
+}
+
+// Adaptive Traffic Light Logic: checks density to assign priority
+void updateTrafficLights(Intersection &ix, Uint32 currentTime)
+{
+  LightController &ctrl = ix.lights;
+
+  if (ctrl.priorityLane == -1) {
+      for (int i = 0; i < 4; i++) {
+          if (countVehiclesOnRoad(ix, i) >= 6) {
+              ctrl.priorityLane = i;
+              logWrite(LOG_INFO, "Priority mode activated for Road %c at intersection %d", 'A' + i, ix.id);
+              break;
+          }
+      }
+  } else {
+      if (countVehiclesOnRoad(ix, ctrl.priorityLane) <= 3) {
+          logWrite(LOG_INFO, "Priority mode deactivated for Road %c at intersection %d", 'A' + ctrl.priorityLane, ix.id);
+          ctrl.priorityLane = -1;
+      }
+  }
+
+  if (!ctrl.isTransitioning) {
+      ctrl.targetPhase = ctrl.lightPhase; 
+      
+      if (ctrl.priorityLane != -1) {
+          if (ctrl.lightPhase != ctrl.priorityLane + 1) {
+              ctrl.targetPhase = ctrl.priorityLane + 1;
+          }
+      } else {
+          if (currentTime - ctrl.lastLightSwitchTime > 3000) { 
+               bool found = false;
+               for (int i = 1; i <= 4; i++) {
+                   int checkIndex = (ctrl.lightPhase - 1 + i) % 4;
+                   if (countVehiclesOnRoad(ix, checkIndex) > 0) {
+                       ctrl.targetPhase = checkIndex + 1;
+                       found = true;
+                       break;
+                   }
+               }
+               
+               if (!found) {
+                   ctrl.targetPhase = (ctrl.lightPhase % 4) + 1;
+               }
+          }
+      }
+  }
+
+  if (ctrl.lightPhase != ctrl.targetPhase) {
+      if (!ctrl.isTransitioning) {
+          ctrl.isTransitioning = true;
+          ctrl.lastLightSwitchTime = currentTime;
+          ix.signal = 0; 
+      } 
+      else {
+          if (currentTime - ctrl.lastLightSwitchTime > 1000) {
+              ctrl.lightPhase = ctrl.targetPhase;
+              ix.signal = ctrl.lightPhase;
+              ctrl.isTransitioning = false;
+              ctrl.lastLightSwitchTime = currentTime;
+          }
+      }
+  } else {
+      if (!ctrl.isTransitioning) {
+           ix.signal = ctrl.lightPhase;
+      }
+  }
+}
+
+// Advances the whole simulation by exactly one fixed SIM_DT_MS step.
+// Rendering and wall-clock pacing live outside, so results do not depend on
+// frame rate or time scale.
+void simulationStep()
+{
+  if (replaying)
+    playbackArrivals();
+  else
+    processIncomingVehicles();
+
+  if (network.regions.size() == 1)
+  {
+    stepRegion(network.regions[0]);
+  }
+  else
+  {
+    JobGroup group;
+    for (Region &region : network.regions)
+      jobs.run(group, [&region]() { stepRegion(region); });
+    jobs.wait(group);
+  }
+
+  // Regions are in id order, which is also the replay log order
+  for (Region &region : network.regions)
+  {
+    for (int id : region.lightChanges)
+      trackLightPhase(network.intersections[id]);
+    region.lightChanges.clear();
+    totalExited += region.exited;
+    totalHandoffs += region.handoffs;
+    region.exited = 0;
+    region.handoffs = 0;
+  }
+  checkMissedLights();
+
+  if (network.owns(viewIntersection))
+    trackViewLight();
+  simTimeMs += SIM_DT_MS;
+  simTick++;
+}
+
+// One step of every intersection in a region. Runs on any thread, touching
+// only the region's intersections, their entry links and outgoing mail.
+void stepRegion(Region &region)
+{
+  network.collectMail(region, simTick);
+  for (int id = region.first; id < region.last; id++)
+  {
+    Intersection &ix = network.intersections[id];
+    if (ix.vehicles.size() > 0)
+      ix.vehicles.savePositions();
+    region.handoffs += deliverLinkArrivals(ix);
+
+    updateTrafficLights(ix, simTimeMs);
+    if (ix.signal != ix.lastSignal)
+      region.lightChanges.push_back(id);
+
+    if (ix.vehicles.size() == 0)
+      continue;
+    updateVehicles(ix);
+
+    // Vehicles leaving the frame either drive onto the link towards the
+    // neighbor on that side or leave the network
+    for (const ExitingVehicle &exit : ix.exits)
+    {
+      int link = ix.exitLink[exit.side];
+      if (link < 0)
+      {
+        region.exited++;
+        region.stoppedTime.record((Uint64)exit.trip.stoppedTicks * SIM_DT_MS * 1000);
+        region.networkTime.record((Uint64)(simTick - exit.trip.spawnTick) * SIM_DT_MS * 1000);
+      }
+      else
+      {
+        network.sendOverLink(region, link, simTick, exit);
+      }
+    }
+  }
+}
+
+// Moves vehicles whose link travel time is over into ix, on an entry lane
+// and path drawn from its own stream. Entry links are always taken in side
+// order so the draws do not depend on when each vehicle was queued.
+// Returns the number of vehicles delivered.
+int deliverLinkArrivals(Intersection &ix)
+{
+  static const int roadLanes[4][2] = {{2, 3}, {4, 5}, {8, 9}, {10, 11}};
+  if (ix.inbound == 0)
+    return 0;
+  int delivered = 0;
+  for (int side = 0; side < 4; side++)
+  {
+    if (ix.entryLink[side] < 0)
+      continue;
+    Link &link = network.links[ix.entryLink[side]];
+    while (!link.inTransit.empty() && link.inTransit.front().arrivalTick <= simTick)
+    {
+      int lane = roadLanes[link.entryRoad][ix.rng.below(2)];
+      int pathOption = (int)ix.rng.below(2);
+      spawnVehicle(ix, lane, pathOption, link.inTransit.front().bodyColor, link.inTransit.front().trip);
+      link.inTransit.pop_front();
+      ix.inbound--;
+      delivered++;
+    }
+  }
+  return delivered;
+}
+
+// Spawns the recorded arrivals due this step and queues the light changes
+// the controller is expected to make
+void playbackArrivals()
+{
+  while (hasPendingReplay && pendingReplay.tick <= simTick && pendingReplay.type != REPLAY_END)
+  {
+    if (pendingReplay.type == REPLAY_ARRIVAL && pendingReplay.intersection < network.intersections.size())
+      spawnArrival(pendingReplay.intersection, pendingReplay.lane, pendingReplay.pathOption);
+    else if (pendingReplay.type == REPLAY_LIGHT)
+      expectedLights.push_back(pendingReplay);
+    hasPendingReplay = replaySource.next(pendingReplay);
+    if (!hasPendingReplay)
+      logWrite(LOG_WARN, "Replay log ends without an end marker at tick %u", simTick);
+  }
+}
+
+// True once every recorded step has been played back
+bool replayDone()
+{
+  if (!replaying)
+    return false;
+  if (!hasPendingReplay)
+    return true;
+  return pendingReplay.type == REPLAY_END && simTick >= pendingReplay.tick;
+}
+
+// Records light changes, or checks them against the log during playback.
+// Intersections are visited in id order, which is also the log order.
+void trackLightPhase(Intersection &ix)
+{
+  if (ix.signal == ix.lastSignal)
+    return;
+  ix.lastSignal = ix.signal;
+  if (replayRecorder.isOpen())
+    replayRecorder.lightChange(simTick, ix.id, ix.signal);
+
+  if (!replaying)
+    return;
+  if (!expectedLights.empty() && expectedLights.front().tick == simTick &&
+      expectedLights.front().intersection == ix.id && expectedLights.front().phase == ix.signal)
+  {
+    expectedLights.pop_front();
+    return;
+  }
+  if (replayDivergences == 0)
+    logWrite(LOG_WARN, "Replay diverged at tick %u: intersection %d light phase %d", simTick, ix.id, ix.signal);
+  replayDivergences++;
+}
+
+// Recorded light changes that did not happen this step are divergences too
+void checkMissedLights()
+{
+  while (!expectedLights.empty() && expectedLights.front().tick <= simTick)
+  {
+    if (replayDivergences == 0)
+      logWrite(LOG_WARN, "Replay diverged at tick %u: intersection %d missed light phase %d", simTick,
+               expectedLights.front().intersection, expectedLights.front().phase);
+    replayDivergences++;
+    expectedLights.pop_front();
+  }
+}
+
+// Flushes the recording and reports how playback went
+void finishReplay()
+{
+  if (replayRecorder.isOpen())
+  {
+    replayRecorder.close(simTick);
+    std::cout << "Replay: recorded " << replayRecorder.recordCount() << " events over " << simTick << " ticks" << std::endl;
+  }
+  if (replaying)
+  {
+    if (replayDivergences == 0)
+      std::cout << "Replay: played back " << simTick << " ticks, light changes match the log" << std::endl;
+    else
+      std::cout << "Replay: played back " << simTick << " ticks, " << replayDivergences << " light changes differ from the log" << std::endl;
+  }
+}
+
+// Accepts a positive multiplier such as 1, 10 or 100, or "max"
+bool parseTimeScale(const char *text, double &scale)
+{
+  if (strcmp(text, "max") == 0)
+  {
+    scale = 0.0;
+    return true;
+  }
+  double value = std::atof(text);
+  if (value <= 0.0)
+    return false;
+  scale = value;
+  return true;
+}
+
+// Accepts COLSxROWS, e.g. 4x3
+bool parseGrid(const char *text, int &cols, int &rows)
+{
+  int c = 0, r = 0;
+  if (sscanf(text, "%dx%d", &c, &r) != 2 || c < 1 || r < 1 || (long long)c * r > MAX_INTERSECTIONS)
+    return false;
+  cols = c;
+  rows = r;
+  return true;
+}
+
+// Worker whose band of intersections contains id
+int clusterRankOf(int id)
+{
+  int n = (int)network.intersections.size();
+  int rank = (int)((long long)id * cluster.workers / n);
+  while (rank + 1 < cluster.workers && RoadNetwork::bandStart(n, cluster.workers, rank + 1) <= id)
+    rank++;
+  while (rank > 0 && RoadNetwork::bandStart(n, cluster.workers, rank) > id)
+    rank--;
+  return rank;
+}
+
+// Connects to the coordinator, retrying while it starts up, and introduces
+// this worker
+bool joinCluster(Uint32 ticks)
+{
+#ifdef _WIN32
+  WSADATA wsaData;
+  if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+  {
+    logWrite(LOG_ERROR, "WSAStartup failed.");
+    return false;
+  }
+#endif
+
+  struct sockaddr_in address;
+  address.sin_family = AF_INET;
+  address.sin_port = htons(cluster.port);
+  if (inet_pton(AF_INET, cluster.host, &address.sin_addr) <= 0)
+  {
+    logWrite(LOG_ERROR, "Invalid coordinator address %s", cluster.host);
+    return false;
+  }
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(CLUSTER_CONNECT_TIMEOUT_MS);
+  while (true)
+  {
+    if ((cluster.socket = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+    {
+      perror("Socket failed");
+      return false;
+    }
+    if (connect(cluster.socket, (struct sockaddr *)&address, sizeof(address)) == 0)
+      break;
+    closesocket(cluster.socket);
+    cluster.socket = (SOCKET)-1;
+    if (std::chrono::steady_clock::now() >= deadline)
+    {
+      logWrite(LOG_ERROR, "No coordinator at %s:%d", cluster.host, cluster.port);
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  setNoDelay(cluster.socket);
+
+  // Links all take the same time to drive, so that is the lookahead
+  cluster.epochTicks = network.links.empty() ? std::max(1u, ticks) : network.links[0].travelSteps;
+  cluster.outgoing.assign(cluster.workers, std::vector<HandoffRecord>());
+
+  ClusterHello hello = {(uint16_t)cluster.rank, (uint16_t)cluster.workers, simSeed, (uint16_t)network.cols,
+                        (uint16_t)network.rows, (uint16_t)network.linkLength, ticks};
+  cluster.out.clear();
+  appendHello(cluster.out, hello);
+  if (!sendAll(cluster.socket, cluster.out.data(), cluster.out.size()))
+    return false;
+  logWrite(LOG_INFO, "Joined the cluster as worker %d/%d, intersections %d-%d, %u step epochs", cluster.rank,
+           cluster.workers, network.ownedFirst, network.ownedLast - 1, cluster.epochTicks);
+  return true;
+}
+
+// End of an epoch: sends the vehicles that drove onto links into other
+// workers' intersections, then takes in the ones handed to this worker and
+// waits for the coordinator to release the next epoch
+bool exchangeBoundary()
+{
+  for (std::vector<HandoffRecord> &records : cluster.outgoing)
+    records.clear();
+  for (Region &region : network.regions)
+  {
+    for (const Handoff &handoff : region.exports)
+    {
+      const LinkVehicle &v = handoff.vehicle;
+      int rank = clusterRankOf(network.links[handoff.link].to);
+      cluster.outgoing[rank].push_back({(uint32_t)handoff.link, v.arrivalTick, v.trip.spawnTick, v.trip.stoppedTicks,
+                                        v.bodyColor.r, v.bodyColor.g, v.bodyColor.b});
+    }
+    cluster.exported += region.exports.size();
+    region.exports.clear();
+  }
+
+  cluster.out.clear();
+  for (int rank = 0; rank < cluster.workers; rank++)
+  {
+    if (!cluster.outgoing[rank].empty())
+      appendHandoffs(cluster.out, (uint16_t)rank, cluster.outgoing[rank].data(), cluster.outgoing[rank].size());
+  }
+  appendEpochEnd(cluster.out, simTick);
+  if (!sendAll(cluster.socket, cluster.out.data(), cluster.out.size()))
+    return false;
+
+  uint8_t type;
+  const uint8_t *payload;
+  uint16_t length;
+  while (recvFrame(cluster.socket, cluster.decoder, type, payload, length))
+  {
+    if (type == MSG_HANDOFF)
+    {
+      size_t count = handoffCount(payload, length);
+      for (size_t i = 0; i < count; i++)
+      {
+        HandoffRecord record = handoffRecord(payload, i);
+        if (record.link >= network.links.size() || !network.owns(network.links[record.link].to))
+        {
+          logWrite(LOG_WARN, "Worker %d got a vehicle for link %u it does not own", cluster.rank, record.link);
+          continue;
+        }
+        network.enterLink((int)record.link, {record.arrivalTick, {record.red, record.green, record.blue, 255},
+                                             {record.spawnTick, record.stoppedTicks}});
+        cluster.imported++;
+      }
+    }
+    else if (type == MSG_EPOCH_END && length >= EPOCH_END_SIZE)
+    {
+      if (getU32(payload) != simTick)
+      {
+        logWrite(LOG_ERROR, "Coordinator released tick %u, worker %d is at tick %u", getU32(payload), cluster.rank, simTick);
+        return false;
+      }
+      cluster.epochs++;
+      return true;
+    }
+  }
+  logWrite(LOG_ERROR, "Lost the coordinator");
+  return false;
+}
+
+// Reports this worker's counters to the coordinator and disconnects
+void leaveCluster()
+{
+  if (cluster.socket == -1)
+    return;
+  WorkerTotals totals = {totalSpawned, totalExited, totalHandoffs, network.vehiclesInIntersections(),
+                         network.vehiclesInTransit()};
+  cluster.out.clear();
+  appendWorkerDone(cluster.out, totals);
+  sendAll(cluster.socket, cluster.out.data(), cluster.out.size());
+  closesocket(cluster.socket);
+  cluster.socket = (SOCKET)-1;
+  std::cout << "Cluster worker " << cluster.rank << "/" << cluster.workers << ": " << cluster.epochs << " epochs, "
+            << cluster.exported << " vehicles sent to other workers, " << cluster.imported << " received" << std::endl;
+}
+
+// Barrier and post office of a distributed run. Every worker steps its own
+// band of the grid; between epochs the coordinator collects each worker's
+// handoffs, routes them to the worker owning the destination and then lets
+// all of them continue. It simulates nothing itself.
+int runCoordinator(const char *host, int workers, int port)
+{
+#ifdef _WIN32
+  WSADATA wsaData;
+  if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+  {
+    logWrite(LOG_ERROR, "WSAStartup failed.");
+    return 1;
+  }
+#endif
+
+  SOCKET server_fd = openListener(host, port, workers);
+  if (server_fd == -1)
+    return 1;
+  logWrite(LOG_INFO, "Coordinator listening on %s:%d for %d workers...", host, port, workers);
+
+  std::vector<SOCKET> sockets(workers, (SOCKET)-1);
+  std::vector<FrameDecoder> decoders(workers);
+  ClusterHello first = {};
+  bool ok = true;
+  for (int joined = 0; ok && joined < workers; joined++)
+  {
+    SOCKET s = accept(server_fd, nullptr, nullptr);
+    if (s == -1)
+    {
+      perror("Accept failed");
+      ok = false;
+      break;
+    }
+    setNoDelay(s);
+
+    // The worker may already be sending its first epoch; those bytes stay in
+    // the decoder, which is kept for the worker
+    FrameDecoder decoder;
+    uint8_t type;
+    const uint8_t *payload;
+    uint16_t length;
+    ClusterHello hello;
+    if (!recvFrame(s, decoder, type, payload, length) || type != MSG_CLUSTER_HELLO || !decodeHello(payload, length, hello))
+    {
+      logWrite(LOG_ERROR, "Connection without a worker hello");
+      closesocket(s);
+      ok = false;
+      break;
+    }
+    if (joined == 0)
+      first = hello;
+    if (hello.workers != workers || hello.rank >= workers || sockets[hello.rank] != -1)
+    {
+      logWrite(LOG_ERROR, "Worker %d/%d does not fit a cluster of %d workers", hello.rank, hello.workers, workers);
+      ok = false;
+    }
+    else if (hello.seed != first.seed || hello.gridCols != first.gridCols || hello.gridRows != first.gridRows ||
+             hello.linkLength != first.linkLength || hello.ticks != first.ticks)
+    {
+      logWrite(LOG_ERROR, "Worker %d was started with a different seed, grid, link length or duration", hello.rank);
+      ok = false;
+    }
+    if (!ok)
+    {
+      closesocket(s);
+      break;
+    }
+    sockets[hello.rank] = s;
+    decoders[hello.rank] = std::move(decoder);
+    logWrite(LOG_INFO, "Worker %d/%d joined", hello.rank, workers);
+  }
+  closesocket(server_fd);
+
+  std::vector<std::vector<uint8_t>> outgoing(workers);
+  WorkerTotals sum = {0, 0, 0, 0, 0};
+  Uint64 epochs = 0, forwarded = 0;
+  int finished = 0;
+  auto wallStart = std::chrono::steady_clock::now();
+
+  while (ok && finished == 0)
+  {
+    // Hear every worker out for this epoch. Reading them one after another
+    // is fine: a worker that is not being read just waits in send().
+    Uint32 epochTick = 0;
+    int ended = 0;
+    for (int rank = 0; ok && rank < workers; rank++)
+    {
+      uint8_t type;
+      const uint8_t *payload;
+      uint16_t length;
+      while (true)
+      {
+        if (!recvFrame(sockets[rank], decoders[rank], type, payload, length))
+        {
+          logWrite(LOG_ERROR, "Lost worker %d", rank);
+          ok = false;
+          break;
+        }
+        if (type == MSG_HANDOFF && length >= HANDOFF_HEADER_SIZE && getU16(payload) < workers)
+        {
+          appendFrame(outgoing[getU16(payload)], MSG_HANDOFF, payload, length);
+          forwarded += handoffCount(payload, length);
+        }
+        else if (type == MSG_EPOCH_END && length >= EPOCH_END_SIZE)
+        {
+          if (ended > 0 && getU32(payload) != epochTick)
+          {
+            logWrite(LOG_ERROR, "Worker %d ended an epoch at tick %u, the others at %u", rank, getU32(payload), epochTick);
+            ok = false;
+          }
+          epochTick = getU32(payload);
+          ended++;
+          break;
+        }
+        else if (type == MSG_WORKER_DONE)
+        {
+          WorkerTotals totals;
+          if (decodeWorkerDone(payload, length, totals))
+          {
+            sum.spawned += totals.spawned;
+            sum.exited += totals.exited;
+            sum.handoffs += totals.handoffs;
+            sum.inIntersections += totals.inIntersections;
+            sum.onLinks += totals.onLinks;
+          }
+          finished++;
+          break;
+        }
+      }
+    }
+    if (!ok)
+      break;
+    if (finished > 0)
+    {
+      if (finished != workers)
+      {
+        logWrite(LOG_ERROR, "Only %d of %d workers finished", finished, workers);
+        ok = false;
+      }
+      break;
+    }
 
-  if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) == -1)
-  {
-    perror("Bind failed");
-    closesocket(server_fd);
-    return;
+    // Deliver the handoffs and release everyone into the next epoch
+    for (int rank = 0; ok && rank < workers; rank++)
+    {
+      appendEpochEnd(outgoing[rank], epochTick);
+      ok = sendAll(sockets[rank], outgoing[rank].data(), outgoing[rank].size());
+      outgoing[rank].clear();
+    }
+    epochs++;
   }
 
-  if (listen(server_fd, 3) < 0)
+  for (SOCKET s : sockets)
   {
-    perror("Listen failed");
-    closesocket(server_fd);
-    return;
+    if (s != -1)
+      closesocket(s);
   }
+#ifdef _WIN32
+  WSACleanup();
+#endif
 
-  std::cout << "Server listening on port " << PORT << "..." << std::endl;
-
-  if ((new_socket = accept(server_fd, (struct sockaddr *)&address, (socklen_t *)&addrlen)) == -1)
+  double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+  logStop();
+  if (!ok)
   {
-    perror("Accept failed");
-    closesocket(server_fd);
-    return;
+    std::cerr << "Cluster run failed" << std::endl;
+    return 1;
   }
+  std::cout << "Cluster run finished: " << workers << " workers, " << first.ticks << " ticks in " << epochs
+            << " epochs, " << wallSeconds << " s wall, " << sum.spawned << " spawned, " << sum.exited << " exited, "
+            << sum.inIntersections + sum.onLinks << " still active" << std::endl;
+  std::cout << "Network: " << first.gridCols << "x" << first.gridRows << " intersections, " << sum.handoffs
+            << " handoffs, " << sum.onLinks << " vehicles on links, " << forwarded << " passed between workers" << std::endl;
+  return 0;
+}
+
+// Runs the simulation without a window on a virtual clock
+int runHeadless(const HeadlessOptions &opts)
+{
+  std::thread receiver_t;
+  if (opts.listen && !replaying)
+    receiver_t = std::thread(socketReceiverThread);
+
+  Uint64 ticks = 0;
+  Uint64 maxTicks = (Uint64)(opts.durationSeconds * 1000.0 / SIM_DT_MS);
+  bool clusterFailed = false;
+  if (cluster.enabled && !joinCluster((Uint32)maxTicks))
+    return 1;
+  double arrivalCredit = 0.0;
+  double arrivalsPerTick = opts.arrivalsPerSecond * SIM_DT_MS / 1000.0;
+
+  if (replaying)
+    logWrite(LOG_INFO, "Headless mode: playing back a recorded run");
+  else if (opts.durationSeconds > 0)
+    logWrite(LOG_INFO, "Headless mode: %.1f s of virtual time, %.2f synthetic arrivals/s", opts.durationSeconds, opts.arrivalsPerSecond);
+  else
+    logWrite(LOG_INFO, "Headless mode: unbounded virtual time, %.2f synthetic arrivals/s", opts.arrivalsPerSecond);
 
-  std::cout << "Client connected (Traffic Generator)..." << std::endl;
+  auto wallStart = std::chrono::steady_clock::now();
 
-  while (true)
+  while ((maxTicks == 0 || ticks < maxTicks) && !replayDone())
   {
-    int bytes_read = recv(new_socket, buffer, BUFFER_SIZE - 1, 0);
-
-    if (bytes_read > 0)
+    // Recorded runs already contain these arrivals
+    arrivalCredit += replaying ? 0.0 : arrivalsPerTick;
+    while (arrivalCredit >= 1.0)
     {
-      buffer[bytes_read] = '\0';
-      std::string receivedData(buffer);
-
-      std::lock_guard<std::mutex> lock(vehicleQueueMutex);
-      vehicleQueue.push_back(receivedData);
+      const EntryPoint &entry = network.entries[arrivalRng.below((Uint32)network.entries.size())];
+      spawnArrival(entry.intersection, entry.lane, (int)arrivalRng.below(2));
+      arrivalCredit -= 1.0;
+    }
 
-      std::cout << "Received: " << receivedData << " (Queue size: " << vehicleQueue.size() << ")" << std::endl;
+    simulationStep();
+    ticks++;
 
-      memset(buffer, 0, BUFFER_SIZE);
-    }
-    else if (bytes_read == 0)
+    if (cluster.enabled && (ticks % cluster.epochTicks == 0 || ticks == maxTicks) && !exchangeBoundary())
     {
-      std::cout << "Client disconnected." << std::endl;
+      clusterFailed = true;
       break;
     }
-    else
+
+    // Pace against the start time rather than sleeping a fixed amount, so
+    // oversleeping one step does not slow the whole run down
+    if (opts.timeScale > 0.0)
     {
-      perror("recv failed");
-      break;
+      double wallMs = ticks * SIM_DT_MS / opts.timeScale;
+      std::this_thread::sleep_until(wallStart + std::chrono::microseconds((long long)(wallMs * 1000.0)));
     }
   }
 
-  closesocket(new_socket);
-  closesocket(server_fd);
+  double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+  logStop();
+  std::cout << "Headless run finished: " << ticks << " ticks (" << ticks * SIM_DT_MS / 1000.0 << " s virtual) in "
+            << wallSeconds << " s wall, " << totalSpawned << " spawned, " << totalExited << " exited, "
+            << network.vehiclesInIntersections() + network.vehiclesInTransit() << " still active, "
+            << vehicleRing.getOverflowCount() << " ingest overflows" << std::endl;
+  if (network.intersections.size() > 1)
+    std::cout << "Network: " << network.cols << "x" << network.rows << " intersections, " << totalHandoffs
+              << " handoffs, " << network.vehiclesInTransit() << " vehicles on links" << std::endl;
+  printIngestStats();
+  printLatencyReport();
+  finishReplay();
+  if (cluster.enabled && !clusterFailed)
+    leaveCluster();
+
+  if (receiver_t.joinable())
+    receiver_t.detach();
+
 #ifdef _WIN32
   WSACleanup();
 #endif
+
+  return clusterFailed ? 1 : 0;
 }
 
 int main(int argc, char *argv[])
 {
+  HeadlessOptions headless = {false, 0.0, 0.0, 0.0, true};
+  double timeScale = -1.0; // unset: windowed runs at 1x, headless flat out
+  size_t ingestCapacity = DEFAULT_INGEST_CAPACITY;
+  OverflowPolicy ingestOverflow = OVERFLOW_DROP;
+  LogLevel logLevel = LOG_VEHICLE;
+  Uint64 seed = (Uint64)std::chrono::steady_clock::now().time_since_epoch().count();
+  const char *recordPath = nullptr;
+  const char *replayPath = nullptr;
+  int gridCols = 1, gridRows = 1;
+  int linkLength = DEFAULT_LINK_LENGTH;
+  int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+  int coordinatorWorkers = 0;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--headless") == 0)
+      headless.enabled = true;
+    else if (strcmp(argv[i], "--bench-turns") == 0)
+      return runTurnBenchmark();
+    else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc)
+      headless.durationSeconds = std::atof(argv[++i]);
+    else if (strcmp(argv[i], "--arrivals") == 0 && i + 1 < argc)
+      headless.arrivalsPerSecond = std::atof(argv[++i]);
+    else if (strcmp(argv[i], "--realtime") == 0)
+      timeScale = 1.0;
+    else if (strcmp(argv[i], "--time-scale") == 0 && i + 1 < argc)
+    {
+      if (!parseTimeScale(argv[++i], timeScale))
+      {
+        std::cerr << "Invalid time scale: " << argv[i] << " (expected a positive number or max)" << std::endl;
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+      seed = std::strtoull(argv[++i], nullptr, 10);
+    else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+      recordPath = argv[++i];
+    else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+      replayPath = argv[++i];
+    else if (strcmp(argv[i], "--grid") == 0 && i + 1 < argc)
+    {
+      if (!parseGrid(argv[++i], gridCols, gridRows))
+      {
+        std::cerr << "Invalid grid: " << argv[i] << " (expected COLSxROWS, at most " << MAX_INTERSECTIONS << " intersections)" << std::endl;
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--link-length") == 0 && i + 1 < argc)
+      linkLength = std::min(65535, std::max(0, std::atoi(argv[++i])));
+    else if (strcmp(argv[i], "--coordinator") == 0 && i + 1 < argc)
+      coordinatorWorkers = std::max(1, std::atoi(argv[++i]));
+    else if (strcmp(argv[i], "--worker") == 0 && i + 1 < argc)
+    {
+      if (sscanf(argv[++i], "%d/%d", &cluster.rank, &cluster.workers) != 2 || cluster.workers < 1 ||
+          cluster.workers > MAX_INTERSECTIONS || cluster.rank < 0 || cluster.rank >= cluster.workers)
+      {
+        std::cerr << "Invalid worker: " << argv[i] << " (expected RANK/WORKERS, e.g. 0/4)" << std::endl;
+        return 1;
+      }
+      cluster.enabled = true;
+    }
+    else if (strcmp(argv[i], "--cluster-host") == 0 && i + 1 < argc)
+      cluster.host = argv[++i];
+    else if (strcmp(argv[i], "--cluster-port") == 0 && i + 1 < argc)
+      cluster.port = std::atoi(argv[++i]);
+    else if (strcmp(argv[i], "--latency-report") == 0 && i + 1 < argc)
+      latencyReportPath = argv[++i];
+    else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+      threads = std::max(1, std::atoi(argv[++i]));
+    else if (strcmp(argv[i], "--no-listen") == 0)
+      headless.listen = false;
+    else if (strcmp(argv[i], "--queue-capacity") == 0 && i + 1 < argc)
+      ingestCapacity = (size_t)std::max(1, std::atoi(argv[++i]));
+    else if (strcmp(argv[i], "--ingest-budget") == 0 && i + 1 < argc)
+      ingestBudget = (size_t)std::max(0, std::atoi(argv[++i]));
+    else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc)
+    {
+      if (!parseLogLevel(argv[++i], logLevel))
+      {
+        std::cerr << "Unknown log level: " << argv[i] << " (expected error, warn, info or vehicle)" << std::endl;
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--overflow") == 0 && i + 1 < argc)
+    {
+      const char *mode = argv[++i];
+      if (strcmp(mode, "drop") == 0)
+        ingestOverflow = OVERFLOW_DROP;
+      else if (strcmp(mode, "block") == 0)
+        ingestOverflow = OVERFLOW_BLOCK;
+      else
+      {
+        std::cerr << "Unknown overflow policy: " << mode << " (expected drop or block)" << std::endl;
+        return 1;
+      }
+    }
+    else
+    {
+      std::cerr << "Unknown argument: " << argv[i] << std::endl;
+      std::cerr << "Usage: " << argv[0] << " [--headless [--duration sec] [--arrivals per_sec] [--realtime] [--no-listen]]"
+                << " [--time-scale x|max] [--seed n] [--record file] [--replay file] [--grid COLSxROWS] [--link-length px] [--threads n] [--coordinator workers | --worker rank/workers] [--cluster-host ip] [--cluster-port port] [--queue-capacity n] [--overflow drop|block] [--ingest-budget n] [--latency-report file]"
+                << " [--log-level error|warn|info|vehicle] [--bench-turns]" << std::endl;
+      return 1;
+    }
+  }
+
+  if (coordinatorWorkers > 0)
+  {
+    logStart(logLevel);
+    return runCoordinator(cluster.host, coordinatorWorkers, cluster.port);
+  }
+  if (cluster.enabled)
+  {
+    // Workers must stop on the same tick and only see synthetic arrivals
+    if (headless.durationSeconds <= 0.0 || replayPath || recordPath)
+    {
+      std::cerr << "A worker needs --duration and cannot record or replay" << std::endl;
+      return 1;
+    }
+    if (cluster.workers > gridCols * gridRows)
+    {
+      std::cerr << "More workers than intersections" << std::endl;
+      return 1;
+    }
+    headless.enabled = true;
+    headless.listen = false;
+  }
+
+  if (replayPath)
+  {
+    if (!replaySource.open(replayPath))
+      return 1;
+    if (replaySource.getStepMs() != SIM_DT_MS)
+    {
+      std::cerr << "Replay was recorded with " << replaySource.getStepMs() << " ms steps, this build uses " << SIM_DT_MS << std::endl;
+      return 1;
+    }
+    seed = replaySource.getSeed();
+    gridCols = std::max(1, (int)replaySource.getNetwork().gridCols);
+    gridRows = std::max(1, (int)replaySource.getNetwork().gridRows);
+    linkLength = replaySource.getNetwork().linkLength;
+    replaying = true;
+    hasPendingReplay = replaySource.next(pendingReplay);
+  }
+  simSeed = seed;
+  colorRng = Pcg32(seed, 1);
+  arrivalRng = Pcg32(seed, 2);
+  network.buildGrid(gridCols, gridRows, linkLength, seed);
+  jobs.start(threads);
+  int intersectionCount = (int)network.intersections.size();
+  if (cluster.enabled || threads > 1)
+  {
+    int first = RoadNetwork::bandStart(intersectionCount, cluster.workers, cluster.rank);
+    int last = RoadNetwork::bandStart(intersectionCount, cluster.workers, cluster.rank + 1);
+    network.partition(first, last, threads > 1 ? threads * REGIONS_PER_THREAD : 1);
+    // A worker reports the lights of its own band
+    if (cluster.enabled)
+      viewIntersection = first;
+  }
+  ReplayNetwork recordedNetwork = {(uint16_t)gridCols, (uint16_t)gridRows, (uint16_t)linkLength};
+  if (recordPath && !replayRecorder.open(recordPath, seed, SIM_DT_MS, recordedNetwork))
+    return 1;
+
+  vehicleRing.init(ingestCapacity, ingestOverflow);
+  logStart(logLevel);
+  logWrite(LOG_INFO, "Simulation seed %llu%s", (unsigned long long)simSeed, replaying ? " (from replay)" : "");
+  if (network.intersections.size() > 1)
+    logWrite(LOG_INFO, "Road network: %dx%d intersections, %d px links", gridCols, gridRows, linkLength);
+
+  if (headless.enabled)
+  {
+    headless.timeScale = timeScale < 0.0 ? 0.0 : timeScale;
+    return runHeadless(headless);
+  }
+  if (timeScale < 0.0)
+    timeScale = 1.0;
+
   // Initialize SDL window and renderer
   SDL_Window *window = nullptr;
   SDL_Renderer *renderer = nullptr;
@@ -196,41 +2503,41 @@ int main(int argc, char *argv[])
     SDL_Log("Failed to load font: %s", SDL_GetError());
   }
 
-  std::thread receiver_t(socketReceiverThread);
+  std::thread receiver_t;
+  if (!replaying)
+    receiver_t = std::thread(socketReceiverThread);
+  bool replayAnnounced = false;
 
   bool running = true;
   SDL_Event event;
 
-  Uint32 lastLightSwitchTime = SDL_GetTicks();
-  int lightPhase = 1;
-  int targetPhase = 1;
-  bool isTransitioning = false;
-  int priorityLane = -1;
-
-  auto countVehiclesOnRoad = [](int roadIndex) -> int {
-      int count = 0;
-      for (const auto& v : activeVehicles) {
-          if (!v.active) continue;
-          if (v.turning) continue;
-
-          if (roadIndex == 0 && v.lane >= 1 && v.lane <= 3) {
-             if (v.y <= 295) count++; 
-          }
-          
-          else if (roadIndex == 1 && v.lane >= 4 && v.lane <= 6) {
-             if (v.y >= 465) count++; 
-          }
-          
-          else if (roadIndex == 2 && v.lane >= 7 && v.lane <= 9) {
-             if (v.x >= 465) count++; 
-          }
-          
-          else if (roadIndex == 3 && v.lane >= 10 && v.lane <= 12) {
-             if (v.x <= 295) count++; 
-          }
-      }
-      return count;
+  // Keys 1-4 switch between these; 0 means as fast as possible
+  static const double scaleKeys[] = {1.0, 10.0, 100.0, 0.0};
+  auto updateTitle = [&]()
+  {
+    char speed[32];
+    if (timeScale > 0.0)
+      SDL_snprintf(speed, sizeof(speed), "%gx", timeScale);
+    else
+      SDL_snprintf(speed, sizeof(speed), "max");
+    char title[96];
+    if (network.intersections.size() > 1)
+    {
+      const Intersection &ix = network.intersections[viewIntersection];
+      SDL_snprintf(title, sizeof(title), "Traffic Simulator (%s) - intersection %d (row %d, col %d)", speed, ix.id, ix.row, ix.col);
+    }
+    else
+      SDL_snprintf(title, sizeof(title), "Traffic Simulator (%s)", speed);
+    SDL_SetWindowTitle(window, title);
+    logWrite(LOG_INFO, "%s", title);
   };
+  updateTitle();
+
+  // Wall time is converted into simulated time through an accumulator and
+  // consumed in fixed steps; whatever is left over becomes the blend factor
+  // between the last two steps when drawing
+  double accumulatorMs = 0.0;
+  Uint64 lastFrameNs = SDL_GetTicksNS();
 
   // Main game loop: handles input, updates, and rendering
   while (running)
@@ -239,110 +2546,83 @@ int main(int argc, char *argv[])
     {
       if (event.type == SDL_EVENT_QUIT)
         running = false;
+      else if (event.type == SDL_EVENT_KEY_DOWN && event.key.key >= SDLK_1 && event.key.key <= SDLK_4)
+      {
+        timeScale = scaleKeys[event.key.key - SDLK_1];
+        updateTitle();
+      }
+      else if (event.type == SDL_EVENT_KEY_DOWN && event.key.key == SDLK_TAB)
+      {
+        // Cycle the intersection shown in the window
+        viewIntersection = (viewIntersection + 1) % (int)network.intersections.size();
+        updateTitle();
+      }
+      else if (event.type == SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED || event.type == SDL_EVENT_RENDER_TARGETS_RESET)
+        invalidateBackground();
+      else if (event.type == SDL_EVENT_RENDER_DEVICE_RESET)
+      {
+        // Every texture lost its contents, including cached text
+        invalidateBackground();
+        textCache.clear();
+      }
     }
 
-    // Process incoming vehicle queue from network thread
-    vehicleQueueMutex.lock();
-    if (!vehicleQueue.empty())
-    {
-      std::string data = vehicleQueue.front();
-      vehicleQueue.erase(vehicleQueue.begin());
-      vehicleQueueMutex.unlock();
+    Uint64 frameStartNs = SDL_GetTicksNS();
+    double frameMs = (frameStartNs - lastFrameNs) / 1000000.0;
+    lastFrameNs = frameStartNs;
+    if (frameMs > MAX_FRAME_MS)
+      frameMs = MAX_FRAME_MS;
 
-      try
-      {
-        if (!data.empty())
-          spawnVehicle(std::stoi(data));
-      }
-      catch (...)
+    float alpha = 1.0f;
+    if (timeScale > 0.0)
+    {
+      accumulatorMs += frameMs * timeScale;
+      int steps = 0;
+      while (accumulatorMs >= SIM_DT_MS && steps < MAX_STEPS_PER_FRAME)
       {
+        simulationStep();
+        accumulatorMs -= SIM_DT_MS;
+        steps++;
       }
+      if (accumulatorMs >= SIM_DT_MS)
+        accumulatorMs = 0.0; // cannot keep up at this scale; drop the backlog
+      alpha = (float)(accumulatorMs / SIM_DT_MS);
     }
     else
     {
-      vehicleQueueMutex.unlock();
-    }
-
-    Uint32 currentTime = SDL_GetTicks();
-    
-    // Adaptive Traffic Light Logic: checks density to assign priority
-    if (priorityLane == -1) {
-        for (int i = 0; i < 4; i++) {
-            if (countVehiclesOnRoad(i) >= 6) {
-                priorityLane = i;
-                std::cout << "Priority mode activated for Road " << (char)('A' + i) << std::endl;
-                break;
-            }
-        }
-    } else {
-        if (countVehiclesOnRoad(priorityLane) <= 3) {
-            std::cout << "Priority mode deactivated for Road " << (char)('A' + priorityLane) << std::endl;
-            priorityLane = -1;
-        }
-    }
-
-    if (!isTransitioning) {
-        targetPhase = lightPhase; 
-        
-        if (priorityLane != -1) {
-            if (lightPhase != priorityLane + 1) {
-                targetPhase = priorityLane + 1;
-            }
-        } else {
-            if (currentTime - lastLightSwitchTime > 3000) { 
-                 bool found = false;
-                 for (int i = 1; i <= 4; i++) {
-                     int checkIndex = (lightPhase - 1 + i) % 4;
-                     if (countVehiclesOnRoad(checkIndex) > 0) {
-                         targetPhase = checkIndex + 1;
-                         found = true;
-                         break;
-                     }
-                 }
-                 
-                 if (!found) {
-                     targetPhase = (lightPhase % 4) + 1;
-                 }
-            }
-        }
+      // Step for most of a frame, then draw the latest state
+      do
+        simulationStep();
+      while (SDL_GetTicksNS() - frameStartNs < MAX_SCALE_FRAME_NS);
+      accumulatorMs = 0.0;
     }
 
-    if (lightPhase != targetPhase) {
-        if (!isTransitioning) {
-            isTransitioning = true;
-            lastLightSwitchTime = currentTime;
-            nextLight = 0; 
-        } 
-        else {
-            if (currentTime - lastLightSwitchTime > 1000) {
-                lightPhase = targetPhase;
-                nextLight = lightPhase;
-                isTransitioning = false;
-                lastLightSwitchTime = currentTime;
-            }
-        }
-    } else {
-        if (!isTransitioning) {
-             nextLight = lightPhase;
-        }
+    if (!replayAnnounced && replayDone())
+    {
+      logWrite(LOG_INFO, "Replay finished at tick %u", simTick);
+      replayAnnounced = true;
     }
 
-    // Update physics for all cars
-    updateVehicles();
-
     // Render everything
     SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
     SDL_RenderClear(renderer);
 
-    drawRoadsAndLane(renderer, font);
-    refreshLight(renderer);
+    drawRoadsAndLane(renderer, font, alpha);
 
     SDL_RenderPresent(renderer);
-    SDL_Delay(16); 
+    if (timeScale > 0.0)
+      SDL_Delay(16);
   }
 
-  receiver_t.detach();
+  if (receiver_t.joinable())
+    receiver_t.detach();
+  logStop();
+  printIngestStats();
+  printLatencyReport();
+  finishReplay();
 
+  invalidateBackground();
+  textCache.clear();
   if (font)
     TTF_CloseFont(font);
   if (renderer)
@@ -396,36 +2676,14 @@ bool initializeSDL(SDL_Window **window, SDL_Renderer **renderer)
   return true;
 }
 
+// Draws white text through the texture cache
 void displayText(SDL_Renderer *renderer, TTF_Font *font, const char *text, int x, int y)
 {
-  SDL_Color textColor = {255, 255, 255, 255};
-  SDL_Surface *textSurface = TTF_RenderText_Solid(font, text, strlen(text), textColor);
-
-  if (!textSurface)
-  {
-    SDL_Log("TTF_RenderText_Solid failed: %s", SDL_GetError());
-    return;
-  }
-
-  SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, textSurface);
-  SDL_DestroySurface(textSurface);
-
-  if (!texture)
-  {
-    SDL_Log("SDL_CreateTextureFromSurface failed: %s", SDL_GetError());
-    return;
-  }
-
-  SDL_FRect textRect = {(float)x, (float)y, 0.0f, 0.0f};
-
-  SDL_GetTextureSize(texture, &textRect.w, &textRect.h);
-
-  SDL_RenderTexture(renderer, texture, NULL, &textRect);
-  SDL_DestroyTexture(texture);
+  textCache.draw(renderer, font, text, (float)x, (float)y, {255, 255, 255, 255});
 }
 
-// Draws static road geometry and markings
-void drawRoadsAndLane(SDL_Renderer *renderer, TTF_Font *font)
+// Draws static road geometry, markings and lane labels
+void drawStaticScene(SDL_Renderer *renderer, TTF_Font *font)
 {
   float center = (float)WINDOW_WIDTH / 2.0f;
   float road_half = (float)ROAD_WIDTH / 2.0f;
@@ -478,36 +2736,85 @@ void drawRoadsAndLane(SDL_Renderer *renderer, TTF_Font *font)
   float leftX = 10.0f;
   float rightX = WINDOW_WIDTH - 60.0f;
 
+  static const char *labels[4][3] = {{"A1", "A2", "A3"}, {"B1", "B2", "B3"}, {"C1", "C2", "C3"}, {"D1", "D2", "D3"}};
   for (int i = 0; i < 3; ++i)
   {
     float xTopBottom = (center - road_half) + laneOffset * i + laneCenterOffset - 10.0f;
-    displayText(renderer, font, (std::string("A") + std::to_string(i + 1)).c_str(), (int)xTopBottom, (int)topY);
-    displayText(renderer, font, (std::string("B") + std::to_string(i + 1)).c_str(), (int)xTopBottom, (int)bottomY);
+    displayText(renderer, font, labels[0][i], (int)xTopBottom, (int)topY);
+    displayText(renderer, font, labels[1][i], (int)xTopBottom, (int)bottomY);
 
     float yLeftRight = (center - road_half) + laneOffset * i + laneCenterOffset - 10.0f;
-    displayText(renderer, font, (std::string("D") + std::to_string(i + 1)).c_str(), (int)leftX, (int)yLeftRight);
-    displayText(renderer, font, (std::string("C") + std::to_string(i + 1)).c_str(), (int)rightX, (int)yLeftRight);
+    displayText(renderer, font, labels[3][i], (int)leftX, (int)yLeftRight);
+    displayText(renderer, font, labels[2][i], (int)rightX, (int)yLeftRight);
+  }
+}
+
+// Renders the static scene into backgroundTexture at the current output size
+bool buildBackground(SDL_Renderer *renderer, TTF_Font *font)
+{
+  int w = 0, h = 0;
+  if (!SDL_GetCurrentRenderOutputSize(renderer, &w, &h))
+    return false;
+
+  backgroundTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, w, h);
+  if (!backgroundTexture)
+  {
+    SDL_Log("Failed to create background texture: %s", SDL_GetError());
+    return false;
   }
 
-  int lState = nextLight.load();
+  SDL_SetRenderTarget(renderer, backgroundTexture);
+  SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+  SDL_RenderClear(renderer);
+  drawStaticScene(renderer, font);
+  SDL_SetRenderTarget(renderer, NULL);
+  return true;
+}
+
+// Forces the background to be rebuilt on the next frame
+void invalidateBackground()
+{
+  if (backgroundTexture)
+    SDL_DestroyTexture(backgroundTexture);
+  backgroundTexture = nullptr;
+}
+
+// Blits the cached background, then draws lights and vehicles on top.
+// alpha blends each vehicle between its previous and current step position
+void drawRoadsAndLane(SDL_Renderer *renderer, TTF_Font *font, float alpha)
+{
+  if (backgroundTexture || buildBackground(renderer, font))
+    SDL_RenderTexture(renderer, backgroundTexture, NULL, NULL);
+  else
+    drawStaticScene(renderer, font);
+
+  const Intersection &ix = network.intersections[viewIntersection];
+  int lState = ix.signal;
   drawLightForA(renderer, lState != 1);
   drawLightForB(renderer, lState != 2);
   drawLightForC(renderer, lState != 3);
   drawLightForD(renderer, lState != 4);
 
-  for (auto &v : activeVehicles)
+  const VehicleStore &vs = ix.vehicles;
+  for (size_t i = 0; i < vs.size(); i++)
   {
-    drawCar(renderer, v);
+    Vehicle v = vs.get(i);
+    v.x = vs.prevX[i] + (v.x - vs.prevX[i]) * alpha;
+    v.y = vs.prevY[i] + (v.y - vs.prevY[i]) * alpha;
+    batchCar(vehicleBatch, v);
   }
+  flushVehicleBatch(renderer, vehicleBatch);
 }
 
-void refreshLight(SDL_Renderer *renderer)
+// Logs phase changes of the intersection shown in the window
+void trackViewLight()
 {
-  if (nextLight.load() == currentLight.load())
+  int signal = network.intersections[viewIntersection].signal;
+  if (signal == currentLight.load())
     return;
 
-  currentLight = nextLight.load();
-  std::cout << "Light state updated to " << currentLight.load() << std::endl;
+  currentLight = signal;
+  logWrite(LOG_INFO, "Light state updated to %d", currentLight.load());
 }
 
 void drawArrow(SDL_Renderer *renderer, int x1, int y1, int x2, int y2, int x3, int y3)
@@ -568,12 +2875,10 @@ void drawTrafficLight(SDL_Renderer *renderer, float x, float y, bool isRed, bool
   SDL_RenderFillRect(renderer, &greenLamp);
 }
 
-void fillRotatedBox(SDL_Renderer* renderer, float cx, float cy, float w, float h, float angleDeg, SDL_Color color)
+// Appends a filled box of size w x h centred on (cx, cy), rotated by the
+// heading whose cosine and sine are c and s
+void batchRotatedBox(VehicleBatch &batch, float cx, float cy, float w, float h, float c, float s, SDL_FColor color)
 {
-    float rad = angleDeg * 3.14159f / 180.0f;
-    float c = std::cos(rad);
-    float s = std::sin(rad);
-
     float hw = w / 2.0f;
     float hh = h / 2.0f;
 
@@ -582,21 +2887,28 @@ void fillRotatedBox(SDL_Renderer* renderer, float cx, float cy, float w, float h
         {-hw, -hh}, {hw, -hh}, {hw, hh}, {-hw, hh}
     };
 
-    SDL_Vertex verts[4];
+    int base = (int)batch.vertices.size();
     for (int i = 0; i < 4; i++) {
         float rx = corners[i].x * c - corners[i].y * s;
         float ry = corners[i].x * s + corners[i].y * c;
-        verts[i].position.x = cx + rx;
-        verts[i].position.y = cy + ry;
-        verts[i].color = { (float)color.r/255.0f, (float)color.g/255.0f, (float)color.b/255.0f, (float)color.a/255.0f };
-        verts[i].tex_coord = { 0.0f, 0.0f };
+        SDL_Vertex v;
+        v.position.x = cx + rx;
+        v.position.y = cy + ry;
+        v.color = color;
+        v.tex_coord = { 0.0f, 0.0f };
+        batch.vertices.push_back(v);
     }
 
-    int indices[6] = { 0, 1, 2, 2, 3, 0 };
-    SDL_RenderGeometry(renderer, NULL, verts, 4, indices, 6);
+    // The index pattern only depends on the quad number, so it is built once
+    // and reused by later frames
+    size_t quad = (size_t)base / 4;
+    if (batch.indices.size() < (quad + 1) * 6) {
+        int quadIndices[6] = { 0, 1, 2, 2, 3, 0 };
+        for (int k = 0; k < 6; k++)
+            batch.indices.push_back(base + quadIndices[k]);
+    }
 }
 
-
 float getLaneAngle(int lane) {
     if (lane >= 1 && lane <= 3) return 90.0f;
     if (lane >= 4 && lane <= 6) return 270.0f;
@@ -604,62 +2916,92 @@ float getLaneAngle(int lane) {
     return 0.0f;
 }
 
-// Renders individual vehicle with rotation and lighting
-void drawCar(SDL_Renderer *renderer, Vehicle &v)
+// Appends one vehicle (body, windshield, headlights) to the batch
+void batchCar(VehicleBatch &batch, const Vehicle &v)
 {
   if (!v.active) return;
   
-  float angle = getLaneAngle(v.lane);
-  
+  // One heading for all four boxes; straight vehicles use the exact lane heading
+  Heading heading = laneHeading(v.lane);
   if (v.turning) {
+      float angle = getLaneAngle(v.lane);
       float target = getLaneAngle(v.targetLane);
       if (std::abs(target - angle) > 180.0f) {
           if (target < angle) target += 360.0f;
           else angle += 360.0f;
       }
-      angle = angle + (target - angle) * v.t;
+      heading = headingTable.fromDegrees(angle + (target - angle) * v.t);
   }
+  float c = heading.c;
+  float s = heading.s;
 
   float cx = v.x + (v.horizontal ? 20.0f : 12.5f);
   float cy = v.y + (v.horizontal ? 12.5f : 20.0f);
 
-  fillRotatedBox(renderer, cx, cy, 40.0f, 25.0f, angle, v.bodyColor);
+  SDL_FColor body = {v.bodyColor.r / 255.0f, v.bodyColor.g / 255.0f, v.bodyColor.b / 255.0f, v.bodyColor.a / 255.0f};
+  batchRotatedBox(batch, cx, cy, 40.0f, 25.0f, c, s, body);
 
-  fillRotatedBox(renderer, 
-      cx + 10.0f * std::cos(angle * 3.14159f/180.0f), 
-      cy + 10.0f * std::sin(angle * 3.14159f/180.0f), 
-      8.0f, 19.0f, angle, {150, 200, 255, 255});
+  batchRotatedBox(batch, cx + 10.0f * c, cy + 10.0f * s, 8.0f, 19.0f, c, s, {150 / 255.0f, 200 / 255.0f, 1.0f, 1.0f});
 
-  float rad = angle * 3.14159f / 180.0f;
-  float c = std::cos(rad);
-  float s = std::sin(rad);
-  
-  auto drawHeadlight = [&](float lx, float ly) {
+  auto batchHeadlight = [&](float lx, float ly) {
       float rx = lx * c - ly * s;
       float ry = lx * s + ly * c;
-      fillRotatedBox(renderer, cx + rx, cy + ry, 4.0f, 4.0f, angle, {255, 255, 150, 255});
+      batchRotatedBox(batch, cx + rx, cy + ry, 4.0f, 4.0f, c, s, {1.0f, 1.0f, 150 / 255.0f, 1.0f});
   };
-  drawHeadlight(18.0f, -8.0f);
-  drawHeadlight(18.0f, 8.0f);
+  batchHeadlight(18.0f, -8.0f);
+  batchHeadlight(18.0f, 8.0f);
 }
 
+// Draws everything appended since the last flush in a single geometry call
+void flushVehicleBatch(SDL_Renderer *renderer, VehicleBatch &batch)
+{
+  size_t quads = batch.vertices.size() / 4;
+  if (quads > 0)
+    SDL_RenderGeometry(renderer, NULL, batch.vertices.data(), (int)batch.vertices.size(), batch.indices.data(), (int)(quads * 6));
+  batch.vertices.clear();
+}
 
+// Lanes vehicles can enter an intersection on; 1, 6, 7 and 12 only carry turning traffic out
+bool isEntryLane(int lane)
+{
+  return lane >= 1 && lane <= 12 && lane != 1 && lane != 6 && lane != 7 && lane != 12;
+}
 
+// Vehicle arriving from outside the network: draws its color, records it for
+// replay and counts it
+void spawnArrival(int intersection, int lane, int pathOption)
+{
+  if (!isEntryLane(lane))
+    return;
 
+  Uint8 r = (Uint8)colorRng.below(255);
+  Uint8 g = (Uint8)colorRng.below(255);
+  Uint8 b = (Uint8)colorRng.below(255);
+  // In a cluster every worker draws every color, so the streams stay in step
+  if (!network.owns(intersection))
+    return;
+  if (replayRecorder.isOpen())
+    replayRecorder.arrival(simTick, intersection, lane, pathOption);
+  spawnVehicle(network.intersections[intersection], lane, pathOption, {r, g, b, 255}, {simTick, 0});
+  totalSpawned++;
+}
 
-// Creates a new vehicle object based on lane data
-void spawnVehicle(int lane)
+// Creates a new vehicle object at the start of a lane of ix
+bool spawnVehicle(Intersection &ix, int lane, int pathOption, SDL_Color color, const Trip &trip)
 {
-  if (lane == 1 || lane == 6 || lane == 7 || lane == 12)
-    return;
+  if (!isEntryLane(lane))
+    return false;
 
   Vehicle v;
   v.active = true;
-  v.speed = 2.0f;
-  v.pathOption = std::rand() % 2;
-  v.bodyColor = {(Uint8)(rand() % 255), (Uint8)(rand() % 255), (Uint8)(rand() % 255), 255};
+  v.speed = VEHICLE_SPEED;
+  v.pathOption = pathOption;
+  v.bodyColor = color;
   v.turning = false;
   v.t = 0.0f;
+  v.targetLane = lane;
+  v.targetHorizontal = false;
+  v.trip = trip;
 
   float center = WINDOW_WIDTH / 2.0f;
   float road_half = (float)ROAD_WIDTH / 2.0f;
@@ -719,281 +3061,291 @@ void spawnVehicle(int lane)
     break;
   }
   default:
-    return;
+    return false;
   }
   v.lane = lane;
-  activeVehicles.push_back(v);
+  ix.vehicles.add(v);
+  return true;
 }
 
 // Core update loop: physics, sorting, and logic
-void updateVehicles()
+void updateVehicles(Intersection &ix)
 {
-  int lState = nextLight.load();
-
-  std::vector<Vehicle *> laneGroups[13]; 
-  for (auto &v : activeVehicles)
+  int lState = ix.signal;
+  VehicleStore &vs = ix.vehicles;
+  TurnSet &activeTurns = ix.turns;
+
+  // Lane lists are persistent and already ordered front to back. Turn
+  // completions are applied after the sweep so every lane sees the same
+  // membership for the whole frame.
+  std::vector<Uint32> *laneGroups = ix.laneGroups;
+  std::vector<Uint32> &completedTurns = ix.completedTurns; // slots that reached the end of their curve
+  for (int lane = 1; lane < MAX_LANES; ++lane)
   {
-    if (v.lane >= 1 && v.lane <= 12)
-      laneGroups[v.lane].push_back(&v);
+    const std::deque<Uint32> &order = vs.laneOrder(lane);
+    laneGroups[lane].clear();
+    for (Uint32 slot : order)
+      laneGroups[lane].push_back((Uint32)vs.denseIndex(slot));
   }
-
-  // Sort vehicles to handle rendering depth (painter's algorithm)
-  auto sortLane = [&](int laneStart, int laneEnd, bool vertical, bool increasing)
+  completedTurns.clear();
+
+  // Advance every turning vehicle in one batch. Turning vehicles never check
+  // gaps, and vehicles that start a turn this frame are not advanced until the
+  // next one, so doing this ahead of the lane sweep gives the same result.
+  // Vehicles that finish stay flagged as turning until after the sweep so
+  // they do not also drive forward this frame.
+  advanceTurnsSimd(activeTurns);
+  for (size_t k = activeTurns.size(); k-- > 0;)
   {
-    for (int lane = laneStart; lane <= laneEnd; ++lane)
+    size_t i = vs.denseIndex(activeTurns.owner[k]);
+    vs.x[i] = activeTurns.outX[k];
+    vs.y[i] = activeTurns.outY[k];
+    vs.t[i] = activeTurns.t[k];
+    if (activeTurns.t[k] >= 1.0f)
     {
-      auto &vec = laneGroups[lane];
-      if (vertical)
-      {
-        if (increasing)
-          std::sort(vec.begin(), vec.end(), [](Vehicle *a, Vehicle *b)
-                    { return a->y < b->y; });
-        else
-          std::sort(vec.begin(), vec.end(), [](Vehicle *a, Vehicle *b)
-                    { return a->y > b->y; });
-      }
-      else
-      {
-        if (increasing)
-          std::sort(vec.begin(), vec.end(), [](Vehicle *a, Vehicle *b)
-                    { return a->x < b->x; });
-        else
-          std::sort(vec.begin(), vec.end(), [](Vehicle *a, Vehicle *b)
-                    { return a->x > b->x; });
-      }
+      completedTurns.push_back(activeTurns.owner[k]);
+      activeTurns.removeAt(k);
     }
-  };
-
-  sortLane(1, 3, true, false);
-  sortLane(4, 6, true, true);
-  sortLane(7, 9, false, true);
-  
-  sortLane(10, 12, false, false);
+  }
 
   float minGap = 45.0f;
 
-  // Check for collisions and red lights
-  auto canAdvance = [&](Vehicle *v)
+  // Red light at the stop line; the gap to the vehicle ahead is checked by the caller
+  auto canAdvance = [&](Uint32 i)
   {
-    if ((v->lane >= 1 && v->lane <= 3) && v->y >= 280 && v->y <= 290 && lState != 1)
+    int lane = vs.lane[i];
+    float x = vs.x[i], y = vs.y[i];
+    if ((lane >= 1 && lane <= 3) && y >= 280 && y <= 290 && lState != 1)
       return false;
-    if ((v->lane >= 4 && v->lane <= 6) && v->y <= 480 && v->y >= 470 && lState != 2)
+    if ((lane >= 4 && lane <= 6) && y <= 480 && y >= 470 && lState != 2)
       return false;
-    if ((v->lane >= 7 && v->lane <= 9) && v->x <= 480 && v->x >= 470 && lState != 3)
+    if ((lane >= 7 && lane <= 9) && x <= 480 && x >= 470 && lState != 3)
       return false;
-    if ((v->lane >= 10 && v->lane <= 12) && v->x >= 280 && v->x <= 290 && lState != 4)
+    if ((lane >= 10 && lane <= 12) && x >= 280 && x <= 290 && lState != 4)
       return false;
     return true;
   };
 
-  // Handle Bezier curve interpolation for turning
-  auto updateTurn = [&](Vehicle *v)
+  auto startTurn = [&](LaneWork &work, Uint32 i, int tLane, bool tHorz, float p1x, float p1y, float p2x, float p2y)
   {
-      v->t += v->t_speed;
-
-      
-
-      if (v->t >= 1.0f)
-      {
-          v->t = 1.0f;
-          v->turning = false;
-          v->lane = v->targetLane;
-          v->horizontal = v->targetHorizontal; 
-          v->x = v->p2x;
-          v->y = v->p2y;
-      }
-      else
-      {
-          float u = 1.0f - v->t;
-          float tt = v->t * v->t;
-          float uu = u * u;
-          v->x = uu * v->p0x + 2 * u * v->t * v->p1x + tt * v->p2x;
-          v->y = uu * v->p0y + 2 * u * v->t * v->p1y + tt * v->p2y;
-      }
-  };
-
-  auto startTurn = [&](Vehicle *v, int tLane, bool tHorz, float p1x, float p1y, float p2x, float p2y)
-  {
-      v->turning = true;
-      v->t = 0.0f;
-      v->targetLane = tLane;
-      v->targetHorizontal = tHorz;
-      v->p0x = v->x;
-      v->p0y = v->y;
-      v->p1x = p1x;
-      v->p1y = p1y;
-      v->p2x = p2x;
-      v->p2y = p2y;
-      
-      float dx = v->p0x - v->p2x;
-      float dy = v->p0y - v->p2y;
-      float dist = std::sqrt(dx*dx + dy*dy);
-      
-      float len = dist * 1.11f;
-      if (len < 1.0f) len = 1.0f;
-      v->t_speed = (v->speed * 3.0f) / len; 
+    vs.turning[i] = true;
+    vs.updateWaitingDeferred(i, work.waitingDelta);
+    vs.t[i] = 0.0f;
+    vs.targetLane[i] = tLane;
+    vs.targetHorizontal[i] = tHorz;
+    work.turns.push_back({vs.slotAt(i), vs.speed[i] * SIM_DT, vs.x[i], vs.y[i], p1x, p1y, p2x, p2y});
   };
 
-  auto moveVertical = [&](int laneStart, int laneEnd, bool increasing)
+  auto moveVertical = [&](int lane, bool increasing)
   {
-    for (int lane = laneStart; lane <= laneEnd; ++lane)
+    auto &vec = laneGroups[lane];
+    LaneWork &work = ix.laneWork[lane];
+    for (size_t k = 0; k < vec.size(); ++k)
     {
-      auto &vec = laneGroups[lane];
-      for (size_t i = 0; i < vec.size(); ++i)
-      {
-        Vehicle *v = vec[i];
-        
-        if (v->turning) {
-            updateTurn(v);
-            continue;
-        }
+      Uint32 i = vec[k];
+      if (vs.turning[i])
+        continue;
 
-        if (!canAdvance(v))
-          continue;
+      // Held at the stop line by a red light
+      if (!canAdvance(i))
+      {
+        vs.trip[i].stoppedTicks++;
+        continue;
+      }
 
-        float proposedY = v->y + (increasing ? v->speed : -v->speed);
+      float step = vs.speed[i] * SIM_DT;
+      float proposedY = vs.y[i] + (increasing ? step : -step);
 
-        if (i > 0)
+      // Held behind the vehicle ahead
+      if (k > 0)
+      {
+        float frontY = vs.y[vec[k - 1]];
+        bool blocked = increasing ? frontY - proposedY < minGap : proposedY - frontY < minGap;
+        if (blocked)
         {
-          Vehicle *front = vec[i - 1];
-         
-          if (increasing)
-          {
-            if (front->y - proposedY < minGap)
-              continue;
-          }
-          else
-          {
-            if (proposedY - front->y < minGap)
-              continue;
-          }
+          vs.trip[i].stoppedTicks++;
+          continue;
         }
+      }
 
-        v->y = proposedY;
+      vs.y[i] = proposedY;
+      vs.updateWaitingDeferred(i, work.waitingDelta);
+      float y = proposedY;
 
-       
-       
-        if (v->lane == 3 && v->y >= 307.5f && v->y < 380.0f) 
+      if (vs.lane[i] == 3 && y >= 307.5f && y < 380.0f)
+      {
+        startTurn(work, i, 10, true, 437.5f, 337.5f, 487.5f, 337.5f);
+      }
+      else if (vs.lane[i] == 4 && y <= 467.5f && y > 400.0f)
+      {
+        startTurn(work, i, 9, true, 337.5f, 437.5f, 287.5f, 437.5f);
+      }
+      else if (vs.lane[i] == 2)
+      {
+        if (vs.pathOption[i] == 1 && y >= 407.5f && y <= 445.0f)
         {
-           startTurn(v, 10, true, 437.5f, 337.5f, 487.5f, 337.5f);
+          startTurn(work, i, 9, true, 387.5f, 437.5f, 300.0f, 437.5f);
         }
-       
-        else if (v->lane == 4 && v->y <= 467.5f && v->y > 400.0f)
+        else if (vs.pathOption[i] == 0 && y >= 380.0f && y <= 400.0f)
         {
-           startTurn(v, 9, true, 337.5f, 437.5f, 287.5f, 437.5f);
+          startTurn(work, i, 3, false, 412.5f, y + 50.0f, 437.5f, y + 100.0f);
         }
-        
-       
-        else if (v->lane == 2)
+      }
+      else if (vs.lane[i] == 5)
+      {
+        if (vs.pathOption[i] == 1 && y <= 367.5f && y >= 330.0f)
         {
-            if (v->pathOption == 1 && v->y >= 407.5f && v->y <= 445.0f) 
-            {
-               startTurn(v, 9, true, 387.5f, 437.5f, 300.0f, 437.5f);
-            }
-            else if (v->pathOption == 0 && v->y >= 380.0f && v->y <= 400.0f) 
-            {
-                
-                startTurn(v, 3, false, 412.5f, v->y + 50.0f, 437.5f, v->y + 100.0f);
-            }
+          startTurn(work, i, 10, true, 387.5f, 337.5f, 450.0f, 337.5f);
         }
-       
-        else if (v->lane == 5)
+        else if (vs.pathOption[i] == 0 && y <= 420.0f && y >= 400.0f)
         {
-            if (v->pathOption == 1 && v->y <= 367.5f && v->y >= 330.0f)
-            {
-                startTurn(v, 10, true, 387.5f, 337.5f, 450.0f, 337.5f);
-            }
-            else if (v->pathOption == 0 && v->y <= 420.0f && v->y >= 400.0f) 
-            {
-                startTurn(v, 4, false, 362.5f, v->y - 50.0f, 337.5f, v->y - 100.0f);
-            }
+          startTurn(work, i, 4, false, 362.5f, y - 50.0f, 337.5f, y - 100.0f);
         }
       }
     }
   };
 
-  auto moveHorizontal = [&](int laneStart, int laneEnd, bool increasing)
+  auto moveHorizontal = [&](int lane, bool increasing)
   {
-    for (int lane = laneStart; lane <= laneEnd; ++lane)
+    auto &vec = laneGroups[lane];
+    LaneWork &work = ix.laneWork[lane];
+    for (size_t k = 0; k < vec.size(); ++k)
     {
-      auto &vec = laneGroups[lane];
-      for (size_t i = 0; i < vec.size(); ++i)
-      {
-        Vehicle *v = vec[i];
-
-        if (v->turning) {
-            updateTurn(v);
-            continue;
-        }
+      Uint32 i = vec[k];
+      if (vs.turning[i])
+        continue;
 
-        if (!canAdvance(v))
-          continue;
+      // Held at the stop line by a red light
+      if (!canAdvance(i))
+      {
+        vs.trip[i].stoppedTicks++;
+        continue;
+      }
 
-        float proposedX = v->x + (increasing ? v->speed : -v->speed);
+      float step = vs.speed[i] * SIM_DT;
+      float proposedX = vs.x[i] + (increasing ? step : -step);
 
-        if (i > 0)
+      // Held behind the vehicle ahead
+      if (k > 0)
+      {
+        float frontX = vs.x[vec[k - 1]];
+        bool blocked = increasing ? frontX - proposedX < minGap : proposedX - frontX < minGap;
+        if (blocked)
         {
-          Vehicle *front = vec[i - 1];
-          if (increasing)
-          {
-            if (front->x - proposedX < minGap)
-              continue;
-          }
-          else
-          {
-            if (proposedX - front->x < minGap)
-              continue;
-          }
+          vs.trip[i].stoppedTicks++;
+          continue;
         }
+      }
 
-        v->x = proposedX;
+      vs.x[i] = proposedX;
+      vs.updateWaitingDeferred(i, work.waitingDelta);
+      float x = proposedX;
 
-        if (v->lane == 9 && v->x <= 467.5f && v->x > 420.0f)
+      if (vs.lane[i] == 9 && x <= 467.5f && x > 420.0f)
+      {
+        startTurn(work, i, 3, false, 437.5f, 437.5f, 437.5f, 517.5f);
+      }
+      else if (vs.lane[i] == 10 && x >= 307.5f && x < 380.0f)
+      {
+        startTurn(work, i, 4, false, 337.5f, 337.5f, 337.5f, 257.5f);
+      }
+      else if (vs.lane[i] == 8)
+      {
+        if (vs.pathOption[i] == 1 && x <= 367.5f && x >= 330.0f)
         {
-           startTurn(v, 3, false, 437.5f, 437.5f, 437.5f, 517.5f);
+          startTurn(work, i, 4, false, 337.5f, 387.5f, 337.5f, 270.0f);
         }
-        else if (v->lane == 10 && v->x >= 307.5f && v->x < 380.0f)
+        else if (vs.pathOption[i] == 0 && x <= 420.0f && x >= 400.0f)
         {
-           startTurn(v, 4, false, 337.5f, 337.5f, 337.5f, 257.5f);
+          startTurn(work, i, 9, false, x - 50.0f, 412.5f, x - 100.0f, 437.5f);
         }
-        
-        else if (v->lane == 8)
+      }
+      else if (vs.lane[i] == 11)
+      {
+        if (vs.pathOption[i] == 1 && x >= 407.5f && x <= 445.0f)
         {
-             if (v->pathOption == 1 && v->x <= 367.5f && v->x >= 330.0f)
-             {
-                 startTurn(v, 4, false, 337.5f, 387.5f, 337.5f, 270.0f); 
-             }
-             else if (v->pathOption == 0 && v->x <= 420.0f && v->x >= 400.0f) 
-             {
-                 
-                 startTurn(v, 9, false, v->x - 50.0f, 412.5f, v->x - 100.0f, 437.5f);
-             }
+          startTurn(work, i, 3, false, 437.5f, 387.5f, 437.5f, 530.0f);
         }
-        
-        else if (v->lane == 11)
+        else if (vs.pathOption[i] == 0 && x >= 380.0f && x <= 400.0f)
         {
-            if (v->pathOption == 1 && v->x >= 407.5f && v->x <= 445.0f)
-            {
-                
-                startTurn(v, 3, false, 437.5f, 387.5f, 437.5f, 530.0f);
-            }
-            else if (v->pathOption == 0 && v->x >= 380.0f && v->x <= 400.0f) 
-            {
-                
-                startTurn(v, 10, false, v->x + 50.0f, 362.5f, v->x + 100.0f, 337.5f);
-            }
+          startTurn(work, i, 10, false, x + 50.0f, 362.5f, x + 100.0f, 337.5f);
         }
       }
     }
   };
 
-  moveVertical(1, 3, true);  
-  moveVertical(4, 6, false);  
-  moveHorizontal(7, 9, false); 
-  moveHorizontal(10, 12, true); 
+  // Lanes only meet through turns, and a turn is only finished after the
+  // sweep, so every lane can move on its own. A lane writes nothing but its
+  // own vehicles and LaneWork; the merge below runs in lane order, so the
+  // result matches a serial sweep whatever the thread count.
+  auto moveLane = [&](int lane)
+  {
+    ix.laneWork[lane].reset();
+    if (lane <= 3)
+      moveVertical(lane, true);
+    else if (lane <= 6)
+      moveVertical(lane, false);
+    else if (lane <= 9)
+      moveHorizontal(lane, false);
+    else
+      moveHorizontal(lane, true);
+  };
+
+  if (jobs.threadCount() > 1 && vs.size() >= PARALLEL_LANE_MIN_VEHICLES)
+  {
+    JobGroup group;
+    for (int lane = 1; lane < MAX_LANES; lane++)
+    {
+      if (laneGroups[lane].empty())
+        ix.laneWork[lane].reset();
+      else
+        jobs.run(group, [&moveLane, lane]() { moveLane(lane); });
+    }
+    jobs.wait(group);
+  }
+  else
+  {
+    for (int lane = 1; lane < MAX_LANES; lane++)
+      moveLane(lane);
+  }
+
+  for (int lane = 1; lane < MAX_LANES; lane++)
+  {
+    LaneWork &work = ix.laneWork[lane];
+    vs.applyWaitingDelta(work.waitingDelta);
+    for (const PendingTurn &turn : work.turns)
+      activeTurns.add(turn.slot, turn.step, turn.x0, turn.y0, turn.x1, turn.y1, turn.x2, turn.y2);
+  }
+
+  for (Uint32 slot : completedTurns)
+  {
+    size_t i = vs.denseIndex(slot);
+    int fromLane = vs.lane[i];
+    vs.turning[i] = false;
+    vs.lane[i] = vs.targetLane[i];
+    vs.horizontal[i] = vs.targetHorizontal[i];
+    vs.changeLane(i, fromLane);
+    vs.updateWaiting(i);
+  }
 
-  activeVehicles.erase(std::remove_if(activeVehicles.begin(), activeVehicles.end(),
-                                      [](const Vehicle &v)
-                                      { return v.x < -100 || v.x > 900 || v.y < -100 || v.y > 900; }),
-                       activeVehicles.end());
-}
\ No newline at end of file
+  // Turning vehicles are always inside the intersection, so they never leave here.
+  // The side a vehicle leaves by decides where it goes next.
+  ix.exits.clear();
+  vs.removeIf([&](size_t i)
+              {
+                if (vs.turning[i])
+                  return false;
+                int side;
+                if (vs.y[i] < -EXIT_MARGIN)
+                  side = SIDE_NORTH;
+                else if (vs.y[i] > WINDOW_HEIGHT + EXIT_MARGIN)
+                  side = SIDE_SOUTH;
+                else if (vs.x[i] > WINDOW_WIDTH + EXIT_MARGIN)
+                  side = SIDE_EAST;
+                else if (vs.x[i] < -EXIT_MARGIN)
+                  side = SIDE_WEST;
+                else
+                  return false;
+                ix.exits.push_back({side, vs.bodyColor[i], vs.trip[i]});
+                return true; });
+}
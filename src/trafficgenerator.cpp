@@ -8,6 +8,14 @@
 #include <queue>
 #include <mutex>
 #include <vector>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cmath>
+#include "protocol.h"
+#include "logger.h"
+#include "pcg32.h"
 
 // Standard networking headers for Windows/Linux
 #ifdef _WIN32
@@ -25,92 +33,111 @@ typedef int SOCKET;
 
 #define SERVER_IP "127.0.0.1"
 #define PORT 5000
-#define BUFFER_SIZE 100
 
 // Vehicle structure holding basic info like lane and road ID
 struct Vehicle {
     int lane;          
     int road;           
     int vehicleId;      
+    int pathOption;     // 0 = straight/lane change, 1 = turn, chosen here so runs are reproducible
     double timestamp;   
 };
 
-// Thread-safe Queue class to manage vehicles for each road safely
-class VehicleQueue {
+#define LANES_PER_ROAD 3
+#define LANE_QUEUE_CAPACITY 16384 // per lane, lock-free backend only (power of two)
+#define CACHE_LINE_SIZE 64
+
+// Thread-safe Queue class to manage vehicles for each road safely.
+// Each lane has its own FIFO and every vehicle carries an arrival sequence
+// number, so lane-specific operations are O(1) and dequeue() still returns
+// vehicles in the order they arrived on the road.
+class MutexVehicleQueue {
 private:
-    std::queue<Vehicle> queue;
+    struct Entry {
+        Vehicle vehicle;
+        unsigned long long sequence;
+    };
+
+    std::queue<Entry> laneQueues[LANES_PER_ROAD];
     std::mutex queueMutex;
     int roadId;         
     int vehicleCount;   
+    int queuedCount;
+    unsigned long long nextSequence;
+
+    // Maps a global lane number (1-12) to this road's sub-queue, or -1
+    int laneIndex(int lane) const {
+        int index = lane - (roadId * LANES_PER_ROAD + 1);
+        return (index >= 0 && index < LANES_PER_ROAD) ? index : -1;
+    }
+
+    void popLane(int index, Vehicle& vehicle) {
+        vehicle = laneQueues[index].front().vehicle;
+        laneQueues[index].pop();
+        queuedCount--;
+    }
 
 public:
-    VehicleQueue(int road) : roadId(road), vehicleCount(0) {}
+    MutexVehicleQueue(int road) : roadId(road), vehicleCount(0), queuedCount(0), nextSequence(0) {}
 
     // Adds a vehicle to the queue
-    void enqueue(const Vehicle& vehicle) {
+    bool enqueue(const Vehicle& vehicle) {
         std::lock_guard<std::mutex> lock(queueMutex);
-        queue.push(vehicle);
+        int index = laneIndex(vehicle.lane);
+        if (index < 0) {
+            return false;
+        }
+        laneQueues[index].push({vehicle, nextSequence++});
+        queuedCount++;
         vehicleCount++;
+        return true;
     }
 
-    // Removes and returns the front vehicle
+    // Removes and returns the vehicle that arrived earliest on this road
     bool dequeue(Vehicle& vehicle) {
         std::lock_guard<std::mutex> lock(queueMutex);
-        if (queue.empty()) {
+        int oldest = -1;
+        for (int i = 0; i < LANES_PER_ROAD; i++) {
+            if (laneQueues[i].empty()) {
+                continue;
+            }
+            if (oldest == -1 || laneQueues[i].front().sequence < laneQueues[oldest].front().sequence) {
+                oldest = i;
+            }
+        }
+        if (oldest == -1) {
             return false;
         }
-        vehicle = queue.front();
-        queue.pop();
+        popLane(oldest, vehicle);
         return true;
     }
 
     // Special dequeue for priority handling (specific lane)
     bool dequeueFromLane(int lane, Vehicle& vehicle) {
         std::lock_guard<std::mutex> lock(queueMutex);
-        if (queue.empty()) {
+        int index = laneIndex(lane);
+        if (index < 0 || laneQueues[index].empty()) {
             return false;
         }
-        
-        std::queue<Vehicle> tempQueue;
-        bool found = false;
-        
-        while (!queue.empty()) {
-            Vehicle v = queue.front();
-            queue.pop();
-            if (v.lane == lane && !found) {
-                vehicle = v;
-                found = true;
-            } else {
-                tempQueue.push(v);
-            }
-        }
-        
-        queue = tempQueue;
-        return found;
+        popLane(index, vehicle);
+        return true;
     }
 
     // Counts how many vehicles are in a specific lane
     int countLaneVehicles(int lane) {
         std::lock_guard<std::mutex> lock(queueMutex);
-        int count = 0;
-        std::queue<Vehicle> tempQueue = queue;
-        while (!tempQueue.empty()) {
-            if (tempQueue.front().lane == lane) {
-                count++;
-            }
-            tempQueue.pop();
-        }
-        return count;
+        int index = laneIndex(lane);
+        return index < 0 ? 0 : (int)laneQueues[index].size();
     }
 
     bool isEmpty() {
         std::lock_guard<std::mutex> lock(queueMutex);
-        return queue.empty();
+        return queuedCount == 0;
     }
 
     int size() {
         std::lock_guard<std::mutex> lock(queueMutex);
-        return queue.size();
+        return queuedCount;
     }
 
     int getRoadId() const {
@@ -122,6 +149,193 @@ public:
     }
 };
 
+// Bounded multi-producer/multi-consumer lock-free ring (Vyukov style).
+// Each cell carries a sequence number that tells producers and consumers
+// whether it is free or filled for the current lap around the ring.
+template <typename T>
+class BoundedMpmcQueue {
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        std::atomic<unsigned long long> ticket; // readable by peekTicket without racing on data
+        T data;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> enqueuePos;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> dequeuePos;
+
+public:
+    explicit BoundedMpmcQueue(size_t capacity) : cells(new Cell[capacity]), mask(capacity - 1), enqueuePos(0), dequeuePos(0) {
+        for (size_t i = 0; i < capacity; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+            cells[i].ticket.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    bool push(const T& item, unsigned long long ticket) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false; // full
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = item;
+        cell->ticket.store(ticket, std::memory_order_relaxed);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item) {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false; // empty
+            } else {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        item = cell->data;
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Reads the ticket of the front element without removing it; false if empty
+    bool peekTicket(unsigned long long& ticket) const {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        const Cell* cell = &cells[pos & mask];
+        if (cell->sequence.load(std::memory_order_acquire) != pos + 1) {
+            return false;
+        }
+        ticket = cell->ticket.load(std::memory_order_relaxed);
+        return true;
+    }
+
+    size_t size() const {
+        size_t head = dequeuePos.load(std::memory_order_relaxed);
+        size_t tail = enqueuePos.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+};
+
+// Lock-free drop-in for MutexVehicleQueue: one MPMC ring per lane and an
+// atomic arrival ticket per road. dequeue() takes the lane whose front has
+// the lowest ticket, so road FIFO order holds for a single consumer and is
+// best-effort when several consumers race.
+class LockFreeVehicleQueue {
+private:
+    BoundedMpmcQueue<Vehicle> laneQueues[LANES_PER_ROAD];
+    int roadId;
+    alignas(CACHE_LINE_SIZE) std::atomic<unsigned long long> nextTicket;
+    std::atomic<int> vehicleCount;
+
+    int laneIndex(int lane) const {
+        int index = lane - (roadId * LANES_PER_ROAD + 1);
+        return (index >= 0 && index < LANES_PER_ROAD) ? index : -1;
+    }
+
+public:
+    LockFreeVehicleQueue(int road)
+        : laneQueues{BoundedMpmcQueue<Vehicle>(LANE_QUEUE_CAPACITY),
+                     BoundedMpmcQueue<Vehicle>(LANE_QUEUE_CAPACITY),
+                     BoundedMpmcQueue<Vehicle>(LANE_QUEUE_CAPACITY)},
+          roadId(road), nextTicket(0), vehicleCount(0) {}
+
+    // Adds a vehicle to the queue, false if its lane ring is full
+    bool enqueue(const Vehicle& vehicle) {
+        int index = laneIndex(vehicle.lane);
+        if (index < 0) {
+            return false;
+        }
+        unsigned long long ticket = nextTicket.fetch_add(1, std::memory_order_relaxed);
+        if (!laneQueues[index].push(vehicle, ticket)) {
+            return false;
+        }
+        vehicleCount.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Removes and returns the vehicle that arrived earliest on this road
+    bool dequeue(Vehicle& vehicle) {
+        while (true) {
+            int oldest = -1;
+            unsigned long long oldestTicket = 0;
+            for (int i = 0; i < LANES_PER_ROAD; i++) {
+                unsigned long long ticket;
+                if (laneQueues[i].peekTicket(ticket) && (oldest == -1 || ticket < oldestTicket)) {
+                    oldest = i;
+                    oldestTicket = ticket;
+                }
+            }
+            if (oldest == -1) {
+                return false;
+            }
+            // Another consumer may have taken it in the meantime; look again
+            if (laneQueues[oldest].pop(vehicle)) {
+                return true;
+            }
+        }
+    }
+
+    // Special dequeue for priority handling (specific lane)
+    bool dequeueFromLane(int lane, Vehicle& vehicle) {
+        int index = laneIndex(lane);
+        return index >= 0 && laneQueues[index].pop(vehicle);
+    }
+
+    // Counts how many vehicles are in a specific lane
+    int countLaneVehicles(int lane) {
+        int index = laneIndex(lane);
+        return index < 0 ? 0 : (int)laneQueues[index].size();
+    }
+
+    bool isEmpty() {
+        return size() == 0;
+    }
+
+    int size() {
+        size_t total = 0;
+        for (int i = 0; i < LANES_PER_ROAD; i++) {
+            total += laneQueues[i].size();
+        }
+        return (int)total;
+    }
+
+    int getRoadId() const {
+        return roadId;
+    }
+
+    int getVehicleCount() const {
+        return vehicleCount.load(std::memory_order_relaxed);
+    }
+};
+
+// Queue backend is chosen at build time: make QUEUE_FLAGS=-DLOCKFREE_QUEUE
+#ifdef LOCKFREE_QUEUE
+typedef LockFreeVehicleQueue VehicleQueue;
+#else
+typedef MutexVehicleQueue VehicleQueue;
+#endif
+
 // One queue for each of the 4 roads
 VehicleQueue roadAQueue(0);  
 VehicleQueue roadBQueue(1);  
@@ -146,45 +360,175 @@ int getRoadFromLane(int lane) {
     return -1;
 }
 
+#define VEHICLE_ID_BLOCK 1024
+
+// Shared id counter; producers reserve ids in blocks to avoid touching it per vehicle
+std::atomic<int> nextVehicleIdBlock{1};
+
+// Per-thread view of the id space
+struct VehicleIdBlock {
+    int nextId = 0;
+    int endId = 0;
+
+    int next() {
+        if (nextId == endId) {
+            nextId = nextVehicleIdBlock.fetch_add(VEHICLE_ID_BLOCK, std::memory_order_relaxed);
+            endId = nextId + VEHICLE_ID_BLOCK;
+        }
+        return nextId++;
+    }
+};
+
 // Randomly selects a valid lane for traffic generation
-int generateLane() {
+int generateLane(Pcg32& rng) {
     static const int validLanes[] = {2, 3, 4, 5, 8, 9, 10, 11};
-    int index = std::rand() % 8;
+    int index = (int)rng.below(8);
     return validLanes[index];
 }
 
 // Creates a vehicle and places it in the correct queue
-void generateVehicle() {
-    int lane = generateLane();
+void generateVehicle(Pcg32& rng, VehicleIdBlock& ids, int lane) {
     int road = getRoadFromLane(lane);
     
     if (road == -1) {
-        std::cerr << "Invalid lane generated: " << lane << std::endl;
+        logWrite(LOG_ERROR, "Invalid lane generated: %d", lane);
         return;
     }
 
     Vehicle vehicle;
     vehicle.lane = lane;
     vehicle.road = road;
-    static int globalVehicleId = 1;
-    vehicle.vehicleId = globalVehicleId++;
+    vehicle.vehicleId = ids.next();
+    vehicle.pathOption = (int)rng.below(2);
     vehicle.timestamp = std::chrono::duration<double>(
         std::chrono::steady_clock::now().time_since_epoch()).count();
 
     VehicleQueue* queue = getQueueForLane(lane);
     if (queue) {
-        queue->enqueue(vehicle);
-        std::cout << "Generated vehicle #" << vehicle.vehicleId 
-                  << " for Road " << (char)('A' + road) 
-                  << " Lane " << lane 
-                  << " (Queue size: " << queue->size() << ")" << std::endl;
+        if (!queue->enqueue(vehicle)) {
+            logWrite(LOG_WARN, "Road %c queue full, dropped vehicle #%d", 'A' + road, vehicle.vehicleId);
+            return;
+        }
+        if (logEnabled(LOG_VEHICLE)) {
+            logWrite(LOG_VEHICLE, "Generated vehicle #%d for Road %c Lane %d (Queue size: %d)",
+                     vehicle.vehicleId, 'A' + road, lane, queue->size());
+        }
+    }
+}
+
+#define ARRIVAL_LANES 8
+#define MAX_CATCHUP_BURST 4096
+#define RATE_FLUSH_MS 10      // sender wakeup with --rate unless --flush-ms is given
+#define RATE_BATCH_HEADROOM 2 // with --rate, a batch holds this many wakeups of peak arrivals
+
+enum ArrivalShape {
+    PROFILE_CONSTANT,
+    PROFILE_RUSH_HOUR
+};
+
+// Describes the stochastic arrival process used when --rate is given
+struct ArrivalProfile {
+    double peakRate;                  // vehicles/s across all producers at the busiest moment
+    ArrivalShape shape;
+    double daySeconds;                // wall seconds that represent 24 h for PROFILE_RUSH_HOUR
+    double laneWeights[ARRIVAL_LANES]; // relative weights for lanes 2,3,4,5,8,9,10,11
+};
+
+static const int arrivalLanes[ARRIVAL_LANES] = {2, 3, 4, 5, 8, 9, 10, 11};
+
+// Rate multiplier in (0, 1] at time t: flat, or a 24 h curve with 08:00 and 17:30 peaks
+double arrivalShapeFactor(const ArrivalProfile& profile, double t) {
+    if (profile.shape == PROFILE_CONSTANT) {
+        return 1.0;
+    }
+    double hour = std::fmod(t / profile.daySeconds, 1.0) * 24.0;
+    double morning = std::exp(-std::pow((hour - 8.0) / 1.5, 2.0));
+    double evening = std::exp(-std::pow((hour - 17.5) / 1.5, 2.0));
+    return std::min(1.0, 0.15 + 0.85 * std::max(morning, evening));
+}
+
+// Picks a lane according to the profile's weights
+int pickWeightedLane(const ArrivalProfile& profile, double totalWeight, Pcg32& rng) {
+    double r = rng.uniform() * totalWeight;
+    for (int i = 0; i < ARRIVAL_LANES; i++) {
+        r -= profile.laneWeights[i];
+        if (r < 0.0) {
+            return arrivalLanes[i];
+        }
+    }
+    return arrivalLanes[ARRIVAL_LANES - 1];
+}
+
+// Generates vehicles as a (possibly time-varying) Poisson process against the
+// steady clock. Arrival times are sampled ahead of time and emitted when the clock
+// passes them, so late wakeups are caught up instead of lowering the rate.
+// Time-varying rates use thinning: sample at the peak rate, keep with p = rate(t) / peak.
+void runArrivalEngine(const ArrivalProfile& profile, int producerCount, Pcg32& rng, VehicleIdBlock& ids) {
+    double peak = profile.peakRate / producerCount;
+    double totalWeight = 0.0;
+    for (int i = 0; i < ARRIVAL_LANES; i++) {
+        totalWeight += profile.laneWeights[i];
+    }
+    if (peak <= 0.0 || totalWeight <= 0.0) {
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    double nextArrival = 0.0;
+
+    while (true) {
+        double now = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        int burst = 0;
+        while (nextArrival <= now && burst < MAX_CATCHUP_BURST) {
+            if (rng.uniform() < arrivalShapeFactor(profile, nextArrival)) {
+                generateVehicle(rng, ids, pickWeightedLane(profile, totalWeight, rng));
+                burst++;
+            }
+            nextArrival += -std::log(1.0 - rng.uniform()) / peak;
+        }
+
+        if (nextArrival > now) {
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                      std::chrono::duration<double>(nextArrival)));
+        }
     }
 }
 
 static bool priorityModeActive = false;
 
-// Logic to decide which vehicle to send to the simulator next
-void processQueuesAndSend(SOCKET sock) {
+// Sends a whole buffer, retrying short writes
+bool sendAll(SOCKET sock, const uint8_t* data, size_t len) {
+    size_t sent = 0;
+    while (sent < len) {
+        int n = send(sock, (const char*)data + sent, (int)(len - sent), 0);
+        if (n <= 0) {
+            perror("send failed");
+            return false;
+        }
+        sent += n;
+    }
+    return true;
+}
+
+// Appends a vehicle to the outgoing byte buffer as one framed message
+void encodeVehicle(const Vehicle& vehicle, std::vector<uint8_t>& out) {
+    VehicleMessage msg;
+    msg.vehicleId = (uint32_t)vehicle.vehicleId;
+    msg.lane = (uint8_t)vehicle.lane;
+    msg.road = (uint8_t)vehicle.road;
+    msg.pathOption = (uint8_t)vehicle.pathOption;
+    msg.generatedUs = (int64_t)(vehicle.timestamp * 1e6);
+    msg.sentUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    size_t offset = out.size();
+    out.resize(offset + VEHICLE_MESSAGE_SIZE);
+    encodeVehicleMessage(msg, out.data() + offset);
+}
+
+// Picks the next vehicle to send: AL2 priority first, then the first non-empty road
+bool selectNextVehicle(Vehicle& vehicle, bool& fromPriority) {
     
     int al2Count = roadAQueue.countLaneVehicles(2); 
     
@@ -196,19 +540,9 @@ void processQueuesAndSend(SOCKET sock) {
     }
     
     if (priorityModeActive && al2Count >= 5) {
-        Vehicle vehicle;
         if (roadAQueue.dequeueFromLane(2, vehicle)) {
-            char buffer[BUFFER_SIZE];
-            std::snprintf(buffer, BUFFER_SIZE, "%d", vehicle.lane);
-            
-            if (send(sock, buffer, std::strlen(buffer), 0) == -1) {
-                perror("send failed");
-                return;
-            }
-            int remaining = roadAQueue.countLaneVehicles(2);
-            std::cout << "PRIORITY: Sent vehicle from AL2 (Lane 2) - Remaining: " << remaining 
-                      << " (Queue size: " << roadAQueue.size() << ")" << std::endl;
-            return;
+            fromPriority = true;
+            return true;
         }
     }
     
@@ -218,26 +552,151 @@ void processQueuesAndSend(SOCKET sock) {
     for (int i = 0; i < 4; i++) {
         VehicleQueue* queue = queues[i];
         if (!queue->isEmpty()) {
-            Vehicle vehicle;
             if (queue->dequeue(vehicle)) {
-                char buffer[BUFFER_SIZE];
-                std::snprintf(buffer, BUFFER_SIZE, "%d", vehicle.lane);
-                
-                if (send(sock, buffer, std::strlen(buffer), 0) == -1) {
-                    perror("send failed");
-                    return;
-                }
-                std::cout << "Sent vehicle from Road " << (char)('A' + queue->getRoadId())
-                          << " Lane " << vehicle.lane 
-                          << " (Queue size: " << queue->size() << ")" << std::endl;
-                return; 
+                fromPriority = false;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Drains up to batchSize vehicles from the road queues and sends them in one send() call.
+// Returns the number of vehicles sent, or -1 if the connection failed.
+int processQueuesAndSend(SOCKET sock, int batchSize) {
+    static std::vector<uint8_t> outBuffer;
+    static std::vector<Vehicle> batch;
+    static std::vector<bool> batchPriority;
+    outBuffer.clear();
+    batch.clear();
+    batchPriority.clear();
+
+    Vehicle vehicle;
+    bool fromPriority = false;
+    while ((int)batch.size() < batchSize && selectNextVehicle(vehicle, fromPriority)) {
+        encodeVehicle(vehicle, outBuffer);
+        batch.push_back(vehicle);
+        batchPriority.push_back(fromPriority);
+    }
+
+    if (batch.empty()) {
+        return 0;
+    }
+
+    if (!sendAll(sock, outBuffer.data(), outBuffer.size())) {
+        return -1;
+    }
+
+    if (logEnabled(LOG_VEHICLE)) {
+        for (size_t i = 0; i < batch.size(); i++) {
+            if (batchPriority[i]) {
+                logWrite(LOG_VEHICLE, "PRIORITY: Sent vehicle from AL2 (Lane 2) - Remaining: %d (Queue size: %d)",
+                         roadAQueue.countLaneVehicles(2), roadAQueue.size());
+            } else {
+                logWrite(LOG_VEHICLE, "Sent vehicle from Road %c Lane %d (Queue size: %d)",
+                         'A' + batch[i].road, batch[i].lane, getQueueForLane(batch[i].lane)->size());
             }
         }
+        if (batch.size() > 1) {
+            logWrite(LOG_VEHICLE, "Flushed batch of %d vehicles", (int)batch.size());
+        }
     }
+    return (int)batch.size();
 }
 
-int main()
+int main(int argc, char *argv[])
 {
+  // Batching: how many vehicles go out per wakeup and how often the sender wakes up
+  int batchSize = 1;
+  int flushIntervalMs = 0; // 0 keeps the original random 200-500 ms pacing
+  bool batchSizeGiven = false;
+  bool flushGiven = false;
+  int producerCount = 1;
+  int speedLevel = 0;      // 0 asks on the console
+  uint64_t seed = (uint64_t)std::time(NULL);
+  ArrivalProfile arrivals = {0.0, PROFILE_CONSTANT, 600.0, {1, 1, 1, 1, 1, 1, 1, 1}};
+  LogLevel logLevel = LOG_VEHICLE;
+  for (int i = 1; i < argc; i++)
+  {
+    if (std::strcmp(argv[i], "--batch-size") == 0 && i + 1 < argc)
+    {
+      batchSize = std::max(1, std::atoi(argv[++i]));
+      batchSizeGiven = true;
+    }
+    else if (std::strcmp(argv[i], "--flush-ms") == 0 && i + 1 < argc)
+    {
+      flushIntervalMs = std::max(0, std::atoi(argv[++i]));
+      flushGiven = true;
+    }
+    else if (std::strcmp(argv[i], "--producers") == 0 && i + 1 < argc)
+      producerCount = std::max(1, std::atoi(argv[++i]));
+    else if (std::strcmp(argv[i], "--speed") == 0 && i + 1 < argc)
+      speedLevel = std::min(10, std::max(1, std::atoi(argv[++i])));
+    else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+      seed = std::strtoull(argv[++i], NULL, 10);
+    else if (std::strcmp(argv[i], "--log-level") == 0 && i + 1 < argc)
+    {
+      if (!parseLogLevel(argv[++i], logLevel))
+      {
+        std::cerr << "Unknown log level: " << argv[i] << " (expected error, warn, info or vehicle)" << std::endl;
+        return 1;
+      }
+    }
+    else if (std::strcmp(argv[i], "--rate") == 0 && i + 1 < argc)
+      arrivals.peakRate = std::max(0.0, std::atof(argv[++i]));
+    else if (std::strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+    {
+      const char *shape = argv[++i];
+      if (std::strcmp(shape, "constant") == 0)
+        arrivals.shape = PROFILE_CONSTANT;
+      else if (std::strcmp(shape, "rush-hour") == 0)
+        arrivals.shape = PROFILE_RUSH_HOUR;
+      else
+      {
+        std::cerr << "Unknown profile: " << shape << " (expected constant or rush-hour)" << std::endl;
+        return 1;
+      }
+    }
+    else if (std::strcmp(argv[i], "--day-seconds") == 0 && i + 1 < argc)
+      arrivals.daySeconds = std::max(1.0, std::atof(argv[++i]));
+    else if (std::strcmp(argv[i], "--lane-weights") == 0 && i + 1 < argc)
+    {
+      // Comma separated weights for lanes 2,3,4,5,8,9,10,11
+      const char *list = argv[++i];
+      for (int w = 0; w < ARRIVAL_LANES && *list; w++)
+      {
+        char *end;
+        arrivals.laneWeights[w] = std::max(0.0, std::strtod(list, &end));
+        list = (*end == ',') ? end + 1 : end;
+      }
+    }
+    else
+    {
+      std::cerr << "Unknown argument: " << argv[i] << std::endl;
+      std::cerr << "Usage: " << argv[0] << " [--batch-size n] [--flush-ms ms] [--producers n] [--speed 1-10] [--seed n]"
+                << " [--rate per_sec [--profile constant|rush-hour] [--day-seconds s] [--lane-weights w,...]]"
+                << " [--log-level error|warn|info|vehicle]" << std::endl;
+      return 1;
+    }
+  }
+
+  logStart(logLevel);
+
+  // The default one vehicle per 200-500 ms wakeup cannot keep up with --rate,
+  // so size the sender for the peak rate unless the user chose otherwise
+  if (arrivals.peakRate > 0.0)
+  {
+    if (!flushGiven)
+      flushIntervalMs = RATE_FLUSH_MS;
+    double wakeupMs = flushIntervalMs > 0 ? flushIntervalMs : 350.0; // mean of the random pacing
+    if (!batchSizeGiven)
+      batchSize = std::max(1, (int)std::ceil(arrivals.peakRate * wakeupMs / 1000.0 * RATE_BATCH_HEADROOM));
+    double sendRate = batchSize * 1000.0 / wakeupMs;
+    if (sendRate < arrivals.peakRate)
+      logWrite(LOG_WARN, "Sender moves at most %.1f vehicles/s (--batch-size %d every %.0f ms), below the %.1f vehicles/s "
+               "arrival rate; road queues will grow", sendRate, batchSize, wakeupMs, arrivals.peakRate);
+  }
+
 #ifdef _WIN32
   WSADATA wsaData;
   if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
@@ -274,51 +733,74 @@ int main()
     return 1;
   }
 
-  std::cout << "Connected to server (Simulator)..." << std::endl;
-  std::cout << "Queue-based vehicle generation system initialized." << std::endl;
-  std::cout << "Road A (lanes 1-3), Road B (lanes 4-6), Road C (lanes 7-9), Road D (lanes 10-12)" << std::endl;
+  logWrite(LOG_INFO, "Connected to server (Simulator)...");
+  logWrite(LOG_INFO, "Queue-based vehicle generation system initialized.");
+  logWrite(LOG_INFO, "Road A (lanes 1-3), Road B (lanes 4-6), Road C (lanes 7-9), Road D (lanes 10-12)");
 
-  std::srand((unsigned int)std::time(NULL));
+  std::srand((unsigned int)seed);
 
   // User control for traffic density
-  int speedLevel = 5; 
-  std::cout << "Enter traffic speed (1-10, where 10 is fastest): ";
-  if (std::cin >> speedLevel) {
-      if (speedLevel < 1) speedLevel = 1;
-      if (speedLevel > 10) speedLevel = 10;
-  } else {
-      std::cin.clear();
-      std::cin.ignore(10000, '\n'); 
+  if (speedLevel == 0 && arrivals.peakRate <= 0.0) {
+    speedLevel = 5;
+    logDrain();
+    std::cout << "Enter traffic speed (1-10, where 10 is fastest): ";
+    if (std::cin >> speedLevel) {
+        if (speedLevel < 1) speedLevel = 1;
+        if (speedLevel > 10) speedLevel = 10;
+    } else {
+        std::cin.clear();
+        std::cin.ignore(10000, '\n'); 
+    }
   }
-  std::cout << "Traffic Speed set to: " << speedLevel << "/10" << std::endl;
+  if (arrivals.peakRate > 0.0)
+    logWrite(LOG_INFO, "Arrival engine: %s Poisson process, peak %.1f vehicles/s",
+             arrivals.shape == PROFILE_RUSH_HOUR ? "rush-hour" : "constant", arrivals.peakRate);
+  else
+    logWrite(LOG_INFO, "Traffic Speed set to: %d/10", speedLevel);
+  logWrite(LOG_INFO, "Producers: %d, seed: %llu", producerCount, (unsigned long long)seed);
+  if (flushIntervalMs > 0)
+    logWrite(LOG_INFO, "Sender: up to %d vehicles every %d ms", batchSize, flushIntervalMs);
 
   // Calculate delay based on speed level
-  auto getTrafficDelay = [speedLevel]() -> int {
+  auto getTrafficDelay = [speedLevel](Pcg32& rng) -> int {
       int minDelayBase = 2000 - (speedLevel - 1) * 200; 
       if (minDelayBase < 100) minDelayBase = 100;
       
       int randomRange = 1000 - (speedLevel - 1) * 100; 
       if (randomRange < 50) randomRange = 50;
       
-      return minDelayBase + std::rand() % randomRange;
+      return minDelayBase + (int)rng.below(randomRange);
   };
 
-  // Background thread to continuously generate vehicles
-  std::thread generatorThread([&]() {
-    while (true) {
-      generateVehicle();
-      int delay = getTrafficDelay();
-      std::this_thread::sleep_for(std::chrono::milliseconds(delay));
-    }
-  });
+  // Background threads to continuously generate vehicles, each with its own RNG stream
+  std::vector<std::thread> generatorThreads;
+  for (int p = 0; p < producerCount; p++) {
+    generatorThreads.emplace_back([&, p]() {
+      Pcg32 rng(seed, (uint64_t)p);
+      VehicleIdBlock ids;
+      if (arrivals.peakRate > 0.0) {
+        runArrivalEngine(arrivals, producerCount, rng, ids);
+        return;
+      }
+      while (true) {
+        generateVehicle(rng, ids, generateLane(rng));
+        int delay = getTrafficDelay(rng);
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+      }
+    });
+  }
 
   // Main loop to process queues and send data
   while (true) {
-    processQueuesAndSend(sock);
-    std::this_thread::sleep_for(std::chrono::milliseconds(200 + std::rand() % 300));
+    if (processQueuesAndSend(sock, batchSize) < 0)
+      break;
+    int wait = flushIntervalMs > 0 ? flushIntervalMs : 200 + std::rand() % 300;
+    std::this_thread::sleep_for(std::chrono::milliseconds(wait));
   }
 
-  generatorThread.detach();
+  for (auto& t : generatorThreads)
+    t.detach();
+  logStop();
   closesocket(sock);
 #ifdef _WIN32
   WSACleanup();